@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Arduino.h"
+#include "SensorCommon.h"
+
+/* ************************************************************************** */
+/**
+ * @brief Known formats of sensor service data
+ */
+enum AdvFormat
+{
+	ADV_FMT_UNKNOWN,
+	ADV_FMT_ATC1441,   // custom firmware from atc1441
+	ADV_FMT_PVVX,      // custom firmware from pvvx (fork of atc1441 with many enhancements)
+	ADV_FMT_MIBEACON,  // stock Xiaomi firmware
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Key of frame format - UUID and length of service data packed to one number
+ */
+constexpr uint32_t advFrameKey( uint16_t uuid, size_t length )
+{
+	return ((uint32_t) uuid << 8) | (uint8_t) length;
+}
+
+/**
+ * @brief Finds format of service data by UUID and length. Custom firmware formats have fixed
+ * length, so cases are resolved by compiler into direct comparisons / jump table.
+ * @param[in] uuid UUID of service data
+ * @param[in] length Length of service data
+ * @return Returns format of service data
+ */
+inline AdvFormat advFormat( uint16_t uuid, size_t length )
+{
+	if( length > 0xFF )
+	{
+		return ADV_FMT_UNKNOWN;
+	}
+
+	switch( advFrameKey( uuid, length ) )
+	{
+		case advFrameKey( 0x181A, 13 ) : return ADV_FMT_ATC1441;
+		case advFrameKey( 0x181A, 15 ) : return ADV_FMT_PVVX;
+		default :                        return uuid == 0xFE95 ? ADV_FMT_MIBEACON : ADV_FMT_UNKNOWN;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Parser of fixed length service data format - specialised for every format.
+ * Fields are read directly from received data and stored directly to sensor state, length is already checked by advFormat().
+ * parse() returns mask of values whose callbacks should be called (SENSOR_NEW_*).
+ */
+template<AdvFormat F>
+struct AdvParser;
+
+/**
+ * @brief atc1441 format: MAC (6), temp (BE, 0.1 C), humidity (%), battery (%), voltage (BE, mV), frame counter
+ */
+template<>
+struct AdvParser<ADV_FMT_ATC1441>
+{
+	static uint8_t parse( const uint8_t *data, SensorState *state, time_t timestamp )
+	{
+		return state->setTemp( (int16_t) ((data[6] << 8) | data[7]) / 10.0, timestamp ) |
+				state->setHumidity( data[8], timestamp ) |
+				state->setBat( data[9], ((data[10] << 8) | data[11]) / 1000.0, timestamp );
+	}
+};
+
+/**
+ * @brief pvvx format: MAC (6, LE), temp (LE, 0.01 C), humidity (LE, 0.01 %), voltage (LE, mV),
+ * battery (%), frame counter, flags
+ */
+template<>
+struct AdvParser<ADV_FMT_PVVX>
+{
+	static uint8_t parse( const uint8_t *data, SensorState *state, time_t timestamp )
+	{
+		return state->setTemp( (int16_t) ((data[7] << 8) | data[6]) / 100.0, timestamp ) |
+				state->setHumidity( ((data[9] << 8) | data[8]) / 100.0, timestamp ) |
+				state->setBat( data[12], ((data[11] << 8) | data[10]) / 1000.0, timestamp );
+	}
+};
+
+/* ************************************************************************** */
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#pragma once
+
+/* ************************************************************************** */
+
+#define BLE_AD_TYPE_SERVICE_DATA  0x16 // AD type of service data with 16 bit UUID
+
+/* ************************************************************************** */
+/**
+ * @brief Borrowed (non-owning) view to part of received ADV packet.
+ * Data are valid only during callback call - copy them if you need them later.
+ */
+struct AdvDataView
+{
+	const uint8_t *data;
+	size_t         length;
+	int8_t         rssi;   // RSSI of received packet in dBm (ADV_RSSI_UNKNOWN if not available)
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Finds next 16 bit UUID service data block in raw ADV payload (AD structures), nothing is copied
+ * @param[in] payload Raw ADV payload
+ * @param[in] payloadLength Length of raw ADV payload
+ * @param[in,out] offset Offset of AD structure where search starts (0 for first call), it is moved behind found block
+ * @param[out] uuid UUID of found service data
+ * @param[out] serviceData View to found service data (without UUID)
+ * @return Returns true if service data block was found or false if there are no more blocks
+ */
+inline bool advNextServiceData( const uint8_t *payload, size_t payloadLength, size_t *offset, uint16_t *uuid, AdvDataView *serviceData )
+{
+	for( size_t i = *offset; i + 1 < payloadLength; )
+	{
+		uint8_t adLength = payload[i];
+
+		if( adLength == 0 || i + 1 + adLength > payloadLength )
+		{
+			break;
+		}
+
+		size_t block = i;
+
+		i += 1 + adLength;
+
+		// 16 bit UUID service data: length, type, UUID (2 bytes), data
+		if( payload[block + 1] == BLE_AD_TYPE_SERVICE_DATA && adLength >= 3 )
+		{
+			*offset = i;
+			*uuid = payload[block + 2] | (payload[block + 3] << 8);
+			serviceData->data = payload + block + 4;
+			serviceData->length = adLength - 3;
+			return true;
+		}
+	}
+
+	*offset = payloadLength;
+	return false;
+}
+
+/* ************************************************************************** */
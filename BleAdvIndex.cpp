@@ -0,0 +1,117 @@
+#include "BleAdvIndex.h"
+
+#include <string.h>
+#include "debug.h"
+
+#ifdef DEBUG_TO_SERIAL
+#	include <Arduino.h>
+#endif
+
+/* ************************************************************************** */
+/**
+ * @brief Computes hash of device address
+ * @param[in] mac Device address
+ * @return Returns hash value
+ */
+uint32_t BleAdvIndex::addressHash( const uint8_t *mac )
+{
+	// FNV-1a - first 3 bytes (OUI) are mostly the same for all sensors, so all bytes must be mixed
+	uint32_t hash = 2166136261u;
+
+	for( int i = 0; i < BLE_ADDRESS_LEN; i++ )
+	{
+		hash = (hash ^ mac[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Inserts callback to address index without resizing it
+ * @param[in] mac Device address
+ * @param[in] cbk Pointer to callback class
+ */
+void BleAdvIndex::insertEntry( const uint8_t *mac, BleAdvListenerCbk *cbk )
+{
+	size_t mask = slots - 1;
+
+	for( size_t i = addressHash( mac ) & mask; ; i = (i + 1) & mask )
+	{
+		if( entries[i].cbk == nullptr )
+		{
+			memcpy( entries[i].mac, mac, BLE_ADDRESS_LEN );
+			entries[i].cbk = cbk;
+			count++;
+			return;
+		}
+
+		if( memcmp( entries[i].mac, mac, BLE_ADDRESS_LEN ) == 0 )
+		{
+			SERIAL_PRINTF("Address is already registered - replacing callback\n");
+			entries[i].cbk = cbk;
+			return;
+		}
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Inserts callback for device address - index grows when needed
+ * @param[in] mac Device address
+ * @param[in] cbk Pointer to callback class
+ */
+void BleAdvIndex::insert( const uint8_t *mac, BleAdvListenerCbk *cbk )
+{
+	// keep load factor under 0.5 - grow (and rehash) index when needed
+	if( (count + 1) * 2 > slots )
+	{
+		Entry  *oldEntries = entries;
+		size_t  oldSlots = slots;
+
+		slots = oldSlots ? oldSlots * 2 : 16;
+		entries = new Entry[slots]();
+		count = 0;
+
+		for( size_t i = 0; i < oldSlots; i++ )
+		{
+			if( oldEntries[i].cbk != nullptr )
+			{
+				insertEntry( oldEntries[i].mac, oldEntries[i].cbk );
+			}
+		}
+
+		delete[] oldEntries;
+	}
+
+	insertEntry( mac, cbk );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Finds callback registered for device address
+ * @param[in] mac Device address
+ * @return Returns registered callback or nullptr if address is not registered
+ */
+BleAdvListenerCbk *BleAdvIndex::find( const uint8_t *mac ) const
+{
+	if( count == 0 )
+	{
+		return nullptr;
+	}
+
+	size_t mask = slots - 1;
+
+	// table is never more than half full, so there is always empty slot which ends the search
+	for( size_t i = addressHash( mac ) & mask; entries[i].cbk != nullptr; i = (i + 1) & mask )
+	{
+		if( memcmp( entries[i].mac, mac, BLE_ADDRESS_LEN ) == 0 )
+		{
+			return entries[i].cbk;
+		}
+	}
+
+	return nullptr;
+}
+
+/* ************************************************************************** */
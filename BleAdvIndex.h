@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#pragma once
+
+/* ************************************************************************** */
+
+#define BLE_ADDRESS_LEN  6
+
+class BleAdvListenerCbk;
+
+/* ************************************************************************** */
+/**
+ * @brief Index of registered callbacks by device address (open addressing with linear probing)
+ * @note Index doesn't depend on ESP32 libraries, so it can be built and benchmarked also on host
+ */
+class BleAdvIndex
+{
+public:
+	~BleAdvIndex()
+	{
+		delete[] entries;
+	}
+
+	/**
+	 * @brief Inserts callback for device address - index grows when needed
+	 * @param[in] mac Device address
+	 * @param[in] cbk Pointer to callback class
+	 */
+	void insert( const uint8_t *mac, BleAdvListenerCbk *cbk );
+
+	/**
+	 * @brief Finds callback registered for device address
+	 * @param[in] mac Device address
+	 * @return Returns registered callback or nullptr if address is not registered
+	 */
+	BleAdvListenerCbk *find( const uint8_t *mac ) const;
+
+	/**
+	 * @brief Returns number of registered addresses
+	 * @return Returns number of registered addresses
+	 */
+	size_t size() const
+	{
+		return count;
+	}
+
+private:
+	/**
+	 * @brief One slot of address index
+	 */
+	struct Entry
+	{
+		uint8_t            mac[BLE_ADDRESS_LEN];
+		BleAdvListenerCbk *cbk; // nullptr for empty slot
+	};
+
+	Entry  *entries = nullptr;  // slots of index
+	size_t  slots = 0;          // number of slots (always power of 2)
+	size_t  count = 0;          // number of used slots
+
+	/**
+	 * @brief Computes hash of device address
+	 * @param[in] mac Device address
+	 * @return Returns hash value
+	 */
+	static uint32_t addressHash( const uint8_t *mac );
+
+	/**
+	 * @brief Inserts callback to address index without resizing it
+	 * @param[in] mac Device address
+	 * @param[in] cbk Pointer to callback class
+	 */
+	void insertEntry( const uint8_t *mac, BleAdvListenerCbk *cbk );
+};
+
+/* ************************************************************************** */
@@ -1,94 +1,364 @@
 #include "BleAdvListener.h"
 
 #include "Arduino.h"
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEScan.h>
-#include <BLEAdvertisedDevice.h>
 #include "debug.h"
 
 /* ************************************************************************** */
 
-#define SCAN_TIME  6
+#define SCAN_TIME      6
+#define SCAN_RETRY_MIN 500   // ms - delay of next attempt after failed scan start, doubled after every next failure
+#define SCAN_RETRY_MAX 30000 // ms
+#define CONN_HOLD_TIME 1000  // ms - scan isn't restarted for this time after connPrepare(), so connection can begin
 
 BleAdvListener bleAdvListener;
 
 /* ************************************************************************** */
 /**
- * @brief Class for receiving and forwarding BLE ADV informations
+ * @brief Extracts service data from ADV payload and stores them to ring buffer (called from BT task)
+ * @param[in] cbk Callback of device which sent the packet
+ * @param[in] mac Address of device which sent the packet
+ * @param[in] payload Raw ADV payload (AD structures)
+ * @param[in] payloadLength Length of raw ADV payload
+ * @param[in] rssi RSSI of packet in dBm
  */
-class MyAdvertisedDeviceCallbacks : public BLEAdvertisedDeviceCallbacks
+void BleAdvListener::queuePayload( BleAdvListenerCbk *cbk, const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi )
 {
-    void onResult(BLEAdvertisedDevice advertisedDevice)
-    {
-		if (!advertisedDevice.haveServiceData())
+	// walk AD structures directly in received payload - getServiceData() would return copy of every block
+	size_t      offset = 0;
+	uint16_t    uuid;
+	AdvDataView serviceData;
+
+	while( advNextServiceData( payload, payloadLength, &offset, &uuid, &serviceData ) )
+	{
+		if( serviceData.length > ADV_RING_DATA_MAX )
+		{
+			continue;
+		}
+
+		uint32_t head = ringHead.load( std::memory_order_relaxed );
+		uint32_t used = head - ringTail.load( std::memory_order_acquire );
+
+		if( used >= ADV_RING_SIZE )
 		{
+			ringDropped++;
 			return;
 		}
 
-		int count = advertisedDevice.getServiceDataCount();
-		BLEAddress address = advertisedDevice.getAddress();
+		if( used + 1 > ringHighWater )
+		{
+			ringHighWater = used + 1;
+		}
 
-		for( auto it = bleAdvListener.regCbks.cbegin(); it != bleAdvListener.regCbks.cend(); it++ )
-    	{
-    		for (int i = 0; i < count; i++)
-    		{
-    			std::string serviceData = advertisedDevice.getServiceData(i);
-    			esp_bt_uuid_t *uuid = advertisedDevice.getServiceDataUUID(i).getNative();
+		AdvRecord &rec = ring[head & (ADV_RING_SIZE - 1)];
 
-    			if( uuid->len == ESP_UUID_LEN_16 )
-    			{
-    				(*it)->onAdvData( &address, (uuid->uuid).uuid16, serviceData );
-    			}
-    		}
-    	}
-    }
-};
+		rec.cbk = cbk;
+		memcpy( rec.mac, mac, BLE_ADDRESS_LEN );
+		rec.uuid = uuid;
+		rec.rssi = rssi;
+		rec.length = serviceData.length;
+		memcpy( rec.data, serviceData.data, rec.length );
+
+		ringHead.store( head + 1, std::memory_order_release );
+	}
+}
 
 /* ************************************************************************** */
 /**
- * @brief Initialise BLE ADV listener
- * @param[in] ptrBLEScan Pointer to BLE scan object - if not given, then it will be initialised
+ * @brief Passes all service data waiting in ring buffer to callbacks
  */
-void BleAdvListener::init( BLEScan *ptrBLEScan )
+void BleAdvListener::processRing()
 {
-	pBLEScan = ptrBLEScan ? ptrBLEScan : BLEDevice::getScan();
+	uint32_t tail = ringTail.load( std::memory_order_relaxed );
+	uint32_t head = ringHead.load( std::memory_order_acquire );
+
+	for( ; tail != head; tail++ )
+	{
+		AdvRecord  &rec = ring[tail & (ADV_RING_SIZE - 1)];
+		BLEAddress  address( rec.mac );
+		AdvDataView serviceData = { rec.data, rec.length, rec.rssi };
+
+		rec.cbk->onAdvData( &address, rec.uuid, serviceData );
+
+		// release slot only after callback is done with the data
+		ringTail.store( tail + 1, std::memory_order_release );
+	}
+}
 
-	pBLEScan->setAdvertisedDeviceCallbacks(new MyAdvertisedDeviceCallbacks(), true );
-	pBLEScan->setActiveScan(false);
-	pBLEScan->setInterval(400);
-	pBLEScan->setWindow(150);
+/* ************************************************************************** */
+/**
+ * @brief Method called by scanner for every received ADV report (called from BT task)
+ * @param[in] mac Address of device which sent the packet
+ * @param[in] payload Raw ADV payload (AD structures, scan response is appended)
+ * @param[in] payloadLength Length of raw ADV payload
+ * @param[in] rssi RSSI of packet in dBm (ADV_RSSI_UNKNOWN if not available)
+ */
+void BleAdvListener::onAdvReport( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi )
+{
+	// address lookup is the first thing we do - packets from other devices are dropped without any other work
+	BleAdvListenerCbk *cbk = advIndex.find( mac );
+
+	if( cbk != nullptr )
+	{
+		queuePayload( cbk, mac, payload, payloadLength, rssi );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Initialise BLE ADV listener with scanner of default transport
+ * @param[in] rawMode Set to true to process ADV packets directly from GAP events. BLEScan isn't used in this mode
+ * and BLEAdvertisedDevice isn't created for received packets, which saves lot of CPU time in busy environment.
+ */
+void BleAdvListener::init( bool rawMode )
+{
+	init( bleTransport->createScanner( rawMode ) );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Initialise BLE ADV listener with given scanner
+ * @param[in] scanner Scanner of BLE transport
+ */
+void BleAdvListener::init( BleScanner *scanner )
+{
+	this->scanner = scanner;
+
+	scanner->setCbk( this );
+
+	initMillis = millis();
 	bleStarted = true;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Registers new callback called when ADV packet will be received
+ * @brief Initialise BLE ADV listener without radio - ADV packets are supplied only by injectAdv().
+ * Used for simulation and replay of captured traffic, BLE stack doesn't need to be initialised.
+ */
+void BleAdvListener::initInject()
+{
+	injectMode = true;
+	initMillis = millis();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Injects ADV packet as if it was received by radio. It goes through the same path as received
+ * packets (address index, ring buffer, callbacks called from process()).
+ * Only one task may inject packets and only when listener was initialised by initInject().
+ * @param[in] mac Address of device which sent the packet
+ * @param[in] payload Raw ADV payload (AD structures)
+ * @param[in] payloadLength Length of raw ADV payload
+ * @param[in] rssi RSSI of packet in dBm
+ * @return Returns false if listener isn't in inject mode
+ */
+bool BleAdvListener::injectAdv( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi )
+{
+	// radio would be second producer for ring buffer
+	if( injectMode == false )
+	{
+		return false;
+	}
+
+	BleAdvListenerCbk *cbk = advIndex.find( mac );
+
+	if( cbk != nullptr )
+	{
+		queuePayload( cbk, mac, payload, payloadLength, rssi );
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Registers new callback called when ADV packet from given address will be received
+ * @param[in] address Address of device the callback is interested in
  * @param[in] cbk Pointer to callback class
+ * @note All callbacks must be registered before scanning is started
+ */
+void BleAdvListener::cbkRegister( BLEAddress *address, BleAdvListenerCbk *cbk )
+{
+	advIndex.insert( *address->getNative(), cbk );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Method called by scanner when scan is finished (called from BT task)
+ */
+void BleAdvListener::onScanComplete()
+{
+	// scan time is added to statistics by process() - BT task only records when the scan ended
+	scanStopMillis.store( millis(), std::memory_order_relaxed );
+
+	// next scan is started in the next process() call - there is no blind gap between scans
+	scanRunning.store( false, std::memory_order_release );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Pauses or unpauses ADV listening. In continuous mode running scan is stopped immediately,
+ * otherwise actual scan window is finished first.
+ * @param[in] paused true for pause, false for unpause
+ */
+void BleAdvListener::setPaused( bool paused )
+{
+	this->paused = paused;
+
+	if( paused && continuous && scanRunning )
+	{
+		scanner->stop();
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Enables continuous scan - scan is never stopped unless paused (only if scanner supports it, e.g. in raw mode,
+ * BLEScan keeps list of all devices seen during scan, which would grow without limit)
+ * @param[in] continuous true for continuous scan, false for periodic scans
  */
-void BleAdvListener::cbkRegister( BleAdvListenerCbk *cbk )
+void BleAdvListener::setContinuous( bool continuous )
 {
-	regCbks.push_front( cbk );
+	if( continuous && (scanner == nullptr || scanner->canRunContinuous() == false) )
+	{
+		SERIAL_PRINTF("Continuous scan is not supported by scanner\n");
+		return;
+	}
+
+	this->continuous = continuous;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Sets scan complete state
+ * @brief Sets scan duty cycle - radio listens for @window ms in every @interval ms
+ * @param[in] interval Scan interval in ms
+ * @param[in] window Scan window in ms (must not be greater than interval)
  */
-void BleAdvListener::setScanComplete()
+void BleAdvListener::setDutyCycle( uint16_t interval, uint16_t window )
 {
-	scanRunning = false;
-	nextScan = time( NULL ) + 1;
+	if( window > interval || window == 0 )
+	{
+		return;
+	}
+
+	scanInterval = interval;
+	scanWindow = window;
+
+	// continuous scan would never pick up new parameters - restart it
+	if( continuous && scanRunning )
+	{
+		scanner->stop();
+	}
 }
 
 /* ************************************************************************** */
 /**
- * @brief Callback for setting scan complete state
- * @param[in] foundDevices Results from scanning
+ * @brief Sets scan duty cycle used while at least one connection to sensor is active. Controller interleaves
+ * scan windows with connection events, so lower window gives higher priority to connections.
+ * @param[in] interval Scan interval in ms
+ * @param[in] window Scan window in ms (0 = scan is paused while connection is active)
  */
-void scanCompleteCbk( BLEScanResults foundDevices )
+void BleAdvListener::setConnDutyCycle( uint16_t interval, uint16_t window )
 {
-	bleAdvListener.setScanComplete();
+	if( window > interval || interval == 0 )
+	{
+		return;
+	}
+
+	connScanInterval = interval;
+	connScanWindow = window;
+
+	if( connCount && continuous && scanRunning )
+	{
+		scanner->stop();
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Returns information if connection to sensor can be started now
+ * @return Returns true if connection can be started, false if scan has to be finished first
+ */
+bool BleAdvListener::canConnect()
+{
+	// without scan window for connections scan has to be finished (or stopped by connPrepare()) -
+	// stop of continuous scan is asynchronous, so it is done only after scanner reports it
+	return connScanWindow != 0 || scanRunning == false;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Prepares scan for connection, when canConnect() returned false. Continuous scan is stopped,
+ * periodic one is finished, and scan isn't restarted until connection begins (at most for CONN_HOLD_TIME).
+ * Call it repeatedly while connection is waiting.
+ */
+void BleAdvListener::connPrepare()
+{
+	if( continuous && scanRunning && connHold == false )
+	{
+		scanner->stop();
+	}
+
+	connHold = true;
+	connHoldMillis = millis();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Informs listener that connection to sensor was started - scan is switched to connection duty cycle
+ */
+void BleAdvListener::connBegin()
+{
+	connHold = false;
+
+	// continuous scan is restarted with connection duty cycle (or stopped) - periodic one uses it from next scan
+	if( connCount++ == 0 && continuous && scanRunning )
+	{
+		scanner->stop();
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Informs listener that connection to sensor was finished - after the last one normal duty cycle is used
+ */
+void BleAdvListener::connEnd()
+{
+	if( connCount == 0 )
+	{
+		return;
+	}
+
+	if( --connCount == 0 && continuous && scanRunning )
+	{
+		scanner->stop();
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Returns measured fraction of time in which radio was listening for ADV packets
+ * since init() (time of running scans corrected by duty cycle)
+ * @return Returns value between 0.0 and 1.0
+ */
+float BleAdvListener::getListeningFraction()
+{
+	uint32_t now = millis();
+	uint64_t listening = scanTimeTotal;
+
+	if( scanCounting )
+	{
+		// scan could finish in BT task after last process() call - then its end time is already recorded
+		uint32_t end = scanRunning.load( std::memory_order_acquire ) ? now : scanStopMillis.load( std::memory_order_relaxed );
+
+		listening += (uint64_t) (end - scanStartMillis) * curWindow / curInterval;
+	}
+
+	if( now == initMillis )
+	{
+		return 0.0;
+	}
+
+	return (float) listening / (float) (now - initMillis);
 }
 
 /* ************************************************************************** */
@@ -97,12 +367,43 @@ void scanCompleteCbk( BLEScanResults foundDevices )
  */
 void BleAdvListener::process()
 {
-	if( paused == false )
+	processRing();
+
+	// time of finished scan is added here, so statistics are written only from loop() context
+	if( scanCounting && scanRunning.load( std::memory_order_acquire ) == false )
 	{
-		if( bleStarted == true && scanRunning == false && time(NULL) > nextScan )
+		scanTimeTotal += (uint64_t) (scanStopMillis.load( std::memory_order_relaxed ) - scanStartMillis) * curWindow / curInterval;
+		scanCounting = false;
+	}
+
+	if( connHold && millis() - connHoldMillis >= CONN_HOLD_TIME )
+	{
+		connHold = false;
+	}
+
+	// while connection is active, scan runs with connection duty cycle or is paused
+	if( paused == false && connHold == false && (connCount == 0 || connScanWindow != 0) )
+	{
+		if( bleStarted == true && scanRunning == false && (scanRetryDelay == 0 || millis() - scanFailMillis >= scanRetryDelay) )
 		{
-			pBLEScan->start(SCAN_TIME, scanCompleteCbk, false);
-			scanRunning = true;
+			curInterval = connCount ? connScanInterval : scanInterval;
+			curWindow = connCount ? connScanWindow : scanWindow;
+
+			scanStartMillis = millis();
+			scanRunning = true; // must be set before start - failure is reported asynchronously
+
+			if( scanner->start( curInterval, curWindow, continuous ? 0 : SCAN_TIME ) == false )
+			{
+				scanRunning = false;
+				scanFailMillis = millis();
+				scanRetryDelay = (scanRetryDelay == 0) ? SCAN_RETRY_MIN : ((scanRetryDelay * 2 > SCAN_RETRY_MAX) ? SCAN_RETRY_MAX : scanRetryDelay * 2);
+
+				SERIAL_PRINTF("Failed to start scan - next attempt in %u ms\n", scanRetryDelay );
+				return;
+			}
+
+			scanRetryDelay = 0;
+			scanCounting = true;
 		}
 	}
 }
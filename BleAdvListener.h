@@ -1,12 +1,19 @@
 #include <Arduino.h>
-#include <BLEDevice.h>
-#include <forward_list>
+#include "BleTransport.h"
+#include "AdvPayload.h"
+#include "BleAdvIndex.h"
+#include <atomic>
 
 #pragma once
 
+/* ************************************************************************** */
+
+#define ADV_RING_SIZE      32 // number of records in ADV ring buffer (must be power of 2)
+#define ADV_RING_DATA_MAX  27 // max. length of service data in one record (max. what fits to one ADV packet)
+
 /* ************************************************************************** */
 /**
- * @brief Callback used to receive service data from BLE ADV packets
+ * @brief Callback used to receive service data from BLE ADV packets of one registered device
  */
 class BleAdvListenerCbk
 {
@@ -14,30 +21,57 @@ public:
 	virtual ~BleAdvListenerCbk() {}
 
 	/**
-	 * @brief Method called when ADV packet is received
+	 * @brief Method called when ADV packet is received (called from process(), not from BT task)
 	 * @param[in] address Address of advertised device
 	 * @param[in] serviceDataUUID UUID of advertised service data
-	 * @param[in] serviceData Service data from ADV packet
+	 * @param[in] serviceData Service data from ADV packet (without UUID)
 	 */
-	virtual void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std::string &serviceData ) = 0;
+	virtual void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData ) = 0;
 };
 
 /* ************************************************************************** */
 
-class BleAdvListener
+class BleAdvListener : public BleScannerCbk
 {
 public:
 	/**
-	 * @brief Initialise BLE ADV listener
-	 * @param[in] ptrBLEScan Pointer to BLE scan object - if not given, then it will be initialised
+	 * @brief Initialise BLE ADV listener with scanner of default transport
+	 * @param[in] rawMode Set to true to process ADV packets directly from GAP events. BLEScan isn't used in this mode
+	 * and BLEAdvertisedDevice isn't created for received packets, which saves lot of CPU time in busy environment.
+	 */
+	void init( bool rawMode = false );
+
+	/**
+	 * @brief Initialise BLE ADV listener with given scanner
+	 * @param[in] scanner Scanner of BLE transport
+	 */
+	void init( BleScanner *scanner );
+
+	/**
+	 * @brief Initialise BLE ADV listener without radio - ADV packets are supplied only by injectAdv().
+	 * Used for simulation and replay of captured traffic, BLE stack doesn't need to be initialised.
 	 */
-	void init( BLEScan *ptrBLEScan = nullptr );
+	void initInject();
 
 	/**
-	 * @brief Registers new callback called when ADV packet will be received
+	 * @brief Injects ADV packet as if it was received by radio. It goes through the same path as received
+	 * packets (address index, ring buffer, callbacks called from process()).
+	 * Only one task may inject packets and only when listener was initialised by initInject().
+	 * @param[in] mac Address of device which sent the packet
+	 * @param[in] payload Raw ADV payload (AD structures)
+	 * @param[in] payloadLength Length of raw ADV payload
+	 * @param[in] rssi RSSI of packet in dBm
+	 * @return Returns false if listener isn't in inject mode
+	 */
+	bool injectAdv( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi = ADV_RSSI_UNKNOWN );
+
+	/**
+	 * @brief Registers new callback called when ADV packet from given address will be received
+	 * @param[in] address Address of device the callback is interested in
 	 * @param[in] cbk Pointer to callback class
+	 * @note All callbacks must be registered before scanning is started
 	 */
-	void cbkRegister( BleAdvListenerCbk *cbk );
+	void cbkRegister( BLEAddress *address, BleAdvListenerCbk *cbk );
 
 	/**
 	 * @brief Method to handle everything needed - should be called in every loop() iteration
@@ -45,12 +79,89 @@ public:
 	void process();
 
 	/**
-	 * @brief Pauses or unpauses ADV listening
+	 * @brief Pauses or unpauses ADV listening. In continuous mode running scan is stopped immediately,
+	 * otherwise actual scan window is finished first.
 	 * @param[in] paused true for pause, false for unpause
 	 */
-	void setPaused( bool paused )
+	void setPaused( bool paused );
+
+	/**
+	 * @brief Enables continuous scan - scan is never stopped unless paused (only if scanner supports it, e.g. in raw mode,
+	 * BLEScan keeps list of all devices seen during scan, which would grow without limit)
+	 * @param[in] continuous true for continuous scan, false for periodic scans
+	 */
+	void setContinuous( bool continuous );
+
+	/**
+	 * @brief Sets scan duty cycle - radio listens for @window ms in every @interval ms
+	 * @param[in] interval Scan interval in ms
+	 * @param[in] window Scan window in ms (must not be greater than interval)
+	 */
+	void setDutyCycle( uint16_t interval, uint16_t window );
+
+	/**
+	 * @brief Sets scan duty cycle used while at least one connection to sensor is active. Controller interleaves
+	 * scan windows with connection events, so lower window gives higher priority to connections.
+	 * @param[in] interval Scan interval in ms
+	 * @param[in] window Scan window in ms (0 = scan is paused while connection is active)
+	 */
+	void setConnDutyCycle( uint16_t interval, uint16_t window );
+
+	/**
+	 * @brief Returns information if connection to sensor can be started now
+	 * @return Returns true if connection can be started, false if scan has to be finished first
+	 */
+	bool canConnect();
+
+	/**
+	 * @brief Prepares scan for connection, when canConnect() returned false. Continuous scan is stopped,
+	 * periodic one is finished, and scan isn't restarted until connection begins (at most for CONN_HOLD_TIME).
+	 * Call it repeatedly while connection is waiting.
+	 */
+	void connPrepare();
+
+	/**
+	 * @brief Informs listener that connection to sensor was started - scan is switched to connection duty cycle
+	 */
+	void connBegin();
+
+	/**
+	 * @brief Informs listener that connection to sensor was finished - after the last one normal duty cycle is used
+	 */
+	void connEnd();
+
+	/**
+	 * @brief Returns information if scan runs continuously
+	 * @return Returns true if continuous scan is enabled
+	 */
+	bool isContinuous()
+	{
+		return continuous;
+	}
+
+	/**
+	 * @brief Returns measured fraction of time in which radio was listening for ADV packets
+	 * since init() (time of running scans corrected by duty cycle)
+	 * @return Returns value between 0.0 and 1.0
+	 */
+	float getListeningFraction();
+
+	/**
+	 * @brief Returns number of service data records dropped because ring buffer was full
+	 * @return Returns number of dropped records since init()
+	 */
+	uint32_t getRingDropped()
 	{
-		this->paused = paused;
+		return ringDropped;
+	}
+
+	/**
+	 * @brief Returns max. number of records waiting in ring buffer at once (to check ADV_RING_SIZE)
+	 * @return Returns high water mark of ring buffer since init()
+	 */
+	uint32_t getRingHighWater()
+	{
+		return ringHighWater;
 	}
 
 	/**
@@ -61,26 +172,91 @@ public:
 	{
 		return scanRunning;
 	}
+
+	/**
+	 * @brief Method called by scanner for every received ADV report (called from BT task)
+	 * @param[in] mac Address of device which sent the packet
+	 * @param[in] payload Raw ADV payload (AD structures, scan response is appended)
+	 * @param[in] payloadLength Length of raw ADV payload
+	 * @param[in] rssi RSSI of packet in dBm (ADV_RSSI_UNKNOWN if not available)
+	 */
+	void onAdvReport( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi );
+
+	/**
+	 * @brief Method called by scanner when scan is finished (called from BT task)
+	 */
+	void onScanComplete();
 private:
-	BLEScan *pBLEScan = nullptr;
+	BleScanner *scanner = nullptr;
 
-	bool     scanRunning = false;
+	std::atomic<bool> scanRunning{ false }; // cleared by BT task when scan is finished
 
 	bool     bleStarted = false;
 
 	bool     paused = false;
 
-	time_t   nextScan = 0;
+	bool     injectMode = false;
+
+	bool     continuous = false;
+
+	uint16_t scanInterval = 400; // ms
+	uint16_t scanWindow = 150;   // ms
+
+	uint16_t connScanInterval = 400; // ms - duty cycle used while connection is active
+	uint16_t connScanWindow = 100;   // ms (0 = scan is paused while connection is active)
+	uint8_t  connCount = 0;          // number of active connections
+	bool     connHold = false;       // scan is not restarted - connection is waiting for it (see connPrepare())
+	uint32_t connHoldMillis = 0;     // time of last connPrepare() call
+
+	uint16_t curInterval = 400;  // ms - duty cycle of running scan
+	uint16_t curWindow = 150;    // ms
+
+	uint32_t initMillis = 0;          // time of init() - start of listening statistics
+	uint32_t scanStartMillis = 0;     // time when actual scan was started
+	uint64_t scanTimeTotal = 0;       // ms spent in finished scans (weighted by duty cycle)
+	bool     scanCounting = false;    // started scan isn't added to scanTimeTotal yet
+
+	std::atomic<uint32_t> scanStopMillis{ 0 }; // time when scan was finished (written by BT task)
 
-	std::forward_list<BleAdvListenerCbk *> regCbks; // list of registered callbacks
+	uint32_t scanRetryDelay = 0;      // ms - delay of next scan start after failed one (0 = last start succeeded)
+	uint32_t scanFailMillis = 0;      // time of last failed scan start
 
 	/**
-	 * @brief Sets scan complete state
+	 * @brief Service data from one ADV packet waiting for processing in process()
 	 */
-	void setScanComplete();
+	struct AdvRecord
+	{
+		BleAdvListenerCbk *cbk;
+		uint8_t            mac[BLE_ADDRESS_LEN];
+		uint16_t           uuid;
+		int8_t             rssi;
+		uint8_t            length;
+		uint8_t            data[ADV_RING_DATA_MAX];
+	};
+
+	// lock-free single producer (BT task) / single consumer (process()) ring buffer
+	AdvRecord             ring[ADV_RING_SIZE];
+	std::atomic<uint32_t> ringHead{ 0 }; // written only by producer
+	std::atomic<uint32_t> ringTail{ 0 }; // written only by consumer
+	volatile uint32_t     ringDropped = 0;
+	volatile uint32_t     ringHighWater = 0;
+
+	BleAdvIndex advIndex;  // index of registered callbacks by device address
+
+	/**
+	 * @brief Extracts service data from ADV payload and stores them to ring buffer (called from BT task)
+	 * @param[in] cbk Callback of device which sent the packet
+	 * @param[in] mac Address of device which sent the packet
+	 * @param[in] payload Raw ADV payload (AD structures)
+	 * @param[in] payloadLength Length of raw ADV payload
+	 * @param[in] rssi RSSI of packet in dBm
+	 */
+	void queuePayload( BleAdvListenerCbk *cbk, const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi );
 
-	friend class MyAdvertisedDeviceCallbacks;
-	friend void scanCompleteCbk( BLEScanResults foundDevices );
+	/**
+	 * @brief Passes all service data waiting in ring buffer to callbacks
+	 */
+	void processRing();
 };
 
 /* ************************************************************************** */
@@ -0,0 +1,388 @@
+#include "BleAdvReplay.h"
+#include "debug.h"
+
+/* ************************************************************************** */
+
+#define BTSNOOP_HCI_UNENCAP   1001
+#define BTSNOOP_HCI_UART      1002
+
+#define PCAP_BT_HCI_H4        187
+#define PCAP_BT_HCI_H4_PHDR   201
+#define PCAP_BT_LE_LL         251
+#define PCAP_BT_LE_LL_PHDR    256
+
+#define HCI_H4_EVENT          0x04
+#define HCI_EVT_LE_META       0x3E
+#define HCI_LE_ADV_REPORT     0x02
+
+/* ************************************************************************** */
+/**
+ * @brief Starts replay of capture
+ * @param[in] stream Stream with capture (e.g. file from SD card or SPIFFS)
+ * @param[in] speed Replay speed multiplier (1 = original timing, 10 = 10x faster, 0 = as fast as possible)
+ * @return Returns true if capture format was recognised
+ */
+bool BleAdvReplay::begin( Stream *stream, uint16_t speed )
+{
+	uint8_t header[24];
+
+	this->stream = stream;
+	this->speed = speed;
+	stats = BleAdvReplayStats();
+	recordValid = false;
+
+	if( stream->readBytes( header, 16 ) != 16 )
+	{
+		return false;
+	}
+
+	uint32_t magic = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+
+	if( memcmp( header, "btsnoop\0", 8 ) == 0 )
+	{
+		format = FMT_BTSNOOP;
+		linkType = (header[12] << 24) | (header[13] << 16) | (header[14] << 8) | header[15];
+
+		if( linkType != BTSNOOP_HCI_UNENCAP && linkType != BTSNOOP_HCI_UART )
+		{
+			SERIAL_PRINTF("Not supported btsnoop datalink type %u\n", linkType );
+			return false;
+		}
+	}
+	else if( magic == 0xA1B2C3D4 || magic == 0xD4C3B2A1 || magic == 0xA1B23C4D || magic == 0x4D3CB2A1 )
+	{
+		format = FMT_PCAP;
+		bigEndian = (magic == 0xA1B2C3D4 || magic == 0xA1B23C4D);
+		nanoseconds = (magic == 0xA1B23C4D || magic == 0x4D3CB2A1);
+
+		if( stream->readBytes( header + 16, 8 ) != 8 )
+		{
+			return false;
+		}
+
+		linkType = bigEndian ? ((header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23]) :
+				((header[23] << 24) | (header[22] << 16) | (header[21] << 8) | header[20]);
+
+		if( linkType != PCAP_BT_HCI_H4 && linkType != PCAP_BT_HCI_H4_PHDR &&
+			linkType != PCAP_BT_LE_LL && linkType != PCAP_BT_LE_LL_PHDR )
+		{
+			SERIAL_PRINTF("Not supported pcap linktype %u\n", linkType );
+			return false;
+		}
+	}
+	else
+	{
+		SERIAL_PRINTF("Unknown capture format\n");
+		return false;
+	}
+
+	if( readRecord() == false )
+	{
+		return false;
+	}
+
+	firstTime = recordTime;
+	elapsedMicros = 0;
+	lastMicros = micros();
+	startMillis = millis();
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Reads 32 bit number from capture
+ * @param[out] value Read value
+ * @param[in] big true for big endian, false for little endian
+ * @return Returns false at the end of capture
+ */
+bool BleAdvReplay::read32( uint32_t *value, bool big )
+{
+	uint8_t b[4];
+
+	if( stream->readBytes( b, 4 ) != 4 )
+	{
+		return false;
+	}
+
+	*value = big ? ((b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3]) :
+			((b[3] << 24) | (b[2] << 16) | (b[1] << 8) | b[0]);
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Reads next record from capture to @record buffer
+ * @return Returns false at the end of capture
+ */
+bool BleAdvReplay::readRecord()
+{
+	uint32_t inclLength;
+
+	if( format == FMT_BTSNOOP )
+	{
+		uint32_t origLength, drops, timeHigh, timeLow;
+
+		if( read32( &origLength, true ) == false || read32( &inclLength, true ) == false ||
+			read32( &recordFlags, true ) == false || read32( &drops, true ) == false ||
+			read32( &timeHigh, true ) == false || read32( &timeLow, true ) == false )
+		{
+			return false;
+		}
+
+		recordTime = ((uint64_t) timeHigh << 32) | timeLow;
+	}
+	else
+	{
+		uint32_t sec, frac, origLength;
+
+		if( read32( &sec, bigEndian ) == false || read32( &frac, bigEndian ) == false ||
+			read32( &inclLength, bigEndian ) == false || read32( &origLength, bigEndian ) == false )
+		{
+			return false;
+		}
+
+		recordTime = (uint64_t) sec * 1000000 + (nanoseconds ? frac / 1000 : frac);
+	}
+
+	stats.records++;
+
+	if( inclLength > REPLAY_RECORD_MAX )
+	{
+		// skip too long record - it is not ADV report anyway
+		for( uint32_t skip = inclLength; skip > 0; )
+		{
+			size_t chunk = skip > REPLAY_RECORD_MAX ? REPLAY_RECORD_MAX : skip;
+
+			if( stream->readBytes( record, chunk ) != chunk )
+			{
+				return false;
+			}
+
+			skip -= chunk;
+		}
+
+		recordLength = 0;
+	}
+	else
+	{
+		if( stream->readBytes( record, inclLength ) != inclLength )
+		{
+			return false;
+		}
+
+		recordLength = inclLength;
+	}
+
+	recordValid = true;
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Injects ADV report to listener
+ * @param[in] addressLE Device address in little endian order (as sent over the air)
+ * @param[in] payload ADV payload
+ * @param[in] payloadLength Length of ADV payload
+ * @param[in] rssi RSSI of report in dBm (ADV_RSSI_UNKNOWN if not captured)
+ */
+void BleAdvReplay::inject( const uint8_t *addressLE, const uint8_t *payload, size_t payloadLength, int8_t rssi )
+{
+	uint8_t mac[BLE_ADDRESS_LEN];
+
+	for( int i = 0; i < BLE_ADDRESS_LEN; i++ )
+	{
+		mac[i] = addressLE[BLE_ADDRESS_LEN - 1 - i];
+	}
+
+	uint32_t start = micros();
+
+	bleAdvListener.injectAdv( mac, payload, payloadLength, rssi );
+
+	stats.injectMicros += micros() - start;
+	stats.advReports++;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Parses HCI event with LE advertising report and injects it to listener
+ * @param[in] data HCI event (starting with event code)
+ * @param[in] length Length of HCI event
+ * @return Returns true if ADV report was injected
+ */
+bool BleAdvReplay::injectHciEvent( const uint8_t *data, size_t length )
+{
+	// event code, length, subevent, number of reports, event type, address type, address (6), data length
+	if( length < 13 || data[0] != HCI_EVT_LE_META || data[2] != HCI_LE_ADV_REPORT )
+	{
+		return false;
+	}
+
+	// fields of more reports in one event are interleaved - controllers report them one by one anyway
+	if( data[3] != 1 || 13 + (size_t) data[12] > length )
+	{
+		return false;
+	}
+
+	// RSSI follows ADV data
+	inject( data + 6, data + 13, data[12], (13 + (size_t) data[12] < length) ? (int8_t) data[13 + data[12]] : ADV_RSSI_UNKNOWN );
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Parses LE link layer ADV packet and injects it to listener
+ * @param[in] data Link layer packet (starting with access address)
+ * @param[in] length Length of packet
+ * @param[in] rssi RSSI of packet in dBm (ADV_RSSI_UNKNOWN if not captured)
+ * @return Returns true if ADV report was injected
+ */
+bool BleAdvReplay::injectLinkLayer( const uint8_t *data, size_t length, int8_t rssi )
+{
+	// access address (4), PDU header (2), advertiser address (6)
+	if( length < 12 || data[0] != 0xD6 || data[1] != 0xBE || data[2] != 0x89 || data[3] != 0x8E )
+	{
+		return false;
+	}
+
+	uint8_t pduType = data[4] & 0x0F;
+	uint8_t pduLength = data[5];
+
+	// ADV_IND, ADV_NONCONN_IND, SCAN_RSP, ADV_SCAN_IND
+	if( (pduType != 0 && pduType != 2 && pduType != 4 && pduType != 6) ||
+		pduLength < 6 || 6 + (size_t) pduLength > length )
+	{
+		return false;
+	}
+
+	inject( data + 6, data + 12, pduLength - 6, rssi );
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Injects buffered record according to capture format
+ */
+void BleAdvReplay::injectRecord()
+{
+	bool injected = false;
+
+	if( recordLength == 0 )
+	{
+		// too long record
+	}
+	else if( format == FMT_BTSNOOP && linkType == BTSNOOP_HCI_UART )
+	{
+		injected = record[0] == HCI_H4_EVENT && injectHciEvent( record + 1, recordLength - 1 );
+	}
+	else if( format == FMT_BTSNOOP )
+	{
+		// flags: bit 0 = received, bit 1 = command or event
+		injected = (recordFlags & 0x03) == 0x03 && injectHciEvent( record, recordLength );
+	}
+	else if( linkType == PCAP_BT_HCI_H4 )
+	{
+		injected = record[0] == HCI_H4_EVENT && injectHciEvent( record + 1, recordLength - 1 );
+	}
+	else if( linkType == PCAP_BT_HCI_H4_PHDR )
+	{
+		// 4 bytes of direction pseudo header
+		injected = recordLength > 5 && record[4] == HCI_H4_EVENT && injectHciEvent( record + 5, recordLength - 5 );
+	}
+	else if( linkType == PCAP_BT_LE_LL )
+	{
+		injected = injectLinkLayer( record, recordLength, ADV_RSSI_UNKNOWN );
+	}
+	else if( linkType == PCAP_BT_LE_LL_PHDR )
+	{
+		// 10 bytes of pseudo header (channel, signal, noise, AA offenses, reference AA, flags)
+		// signal power is valid when flag 0x0002 is set
+		injected = recordLength > 10 && injectLinkLayer( record + 10, recordLength - 10,
+				(record[8] & 0x02) ? (int8_t) record[1] : ADV_RSSI_UNKNOWN );
+	}
+
+	if( injected == false )
+	{
+		stats.skipped++;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Replays packets which are due - should be called in every loop() iteration instead of bleAdvListener.process()
+ * @return Returns false when replay is finished
+ */
+bool BleAdvReplay::process()
+{
+	if( stream == nullptr || stats.finished )
+	{
+		return false;
+	}
+
+	uint32_t now = micros();
+
+	// 64 bit time - 32 bit micros() overflows after 71 minutes
+	elapsedMicros += (uint32_t) (now - lastMicros);
+	lastMicros = now;
+
+	for( int i = 0; i < REPLAY_BATCH_MAX; i++ )
+	{
+		if( recordValid == false )
+		{
+			uint32_t start = micros();
+			bool     haveRecord = readRecord();
+
+			stats.parseMicros += micros() - start;
+
+			if( haveRecord == false )
+			{
+				stats.durationMillis = millis() - startMillis;
+				stats.finished = true;
+
+				SERIAL_PRINTF("Replay finished in %u ms: records %u, ADV reports %u, skipped %u\n",
+						stats.durationMillis, stats.records, stats.advReports, stats.skipped );
+				SERIAL_PRINTF("Time spent: parse %u us, inject %u us, decode %u us, max lag %u us\n",
+						stats.parseMicros, stats.injectMicros, stats.decodeMicros, stats.lagMaxMicros );
+				return false;
+			}
+		}
+
+		if( speed )
+		{
+			uint64_t due = (recordTime - firstTime) / speed;
+
+			if( due > elapsedMicros )
+			{
+				break;
+			}
+
+			if( elapsedMicros - due > stats.lagMaxMicros )
+			{
+				stats.lagMaxMicros = elapsedMicros - due;
+			}
+		}
+
+		uint32_t injectBefore = stats.injectMicros;
+		uint32_t start = micros();
+
+		injectRecord();
+		recordValid = false;
+
+		uint32_t decodeStart = micros();
+
+		stats.parseMicros += (decodeStart - start) - (stats.injectMicros - injectBefore);
+
+		// drain ring buffer after every report - it would overflow in as fast as possible mode
+		bleAdvListener.process();
+
+		stats.decodeMicros += micros() - decodeStart;
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
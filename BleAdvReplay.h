@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Arduino.h"
+#include "BleAdvListener.h"
+
+/* ************************************************************************** */
+
+#define REPLAY_RECORD_MAX  300 // max. length of one captured packet - longer packets are skipped
+#define REPLAY_BATCH_MAX   64  // max. number of packets replayed in one process() call
+
+/* ************************************************************************** */
+/**
+ * @brief Statistics of replay run
+ */
+struct BleAdvReplayStats
+{
+	uint32_t records = 0;      // number of records read from capture
+	uint32_t advReports = 0;   // number of ADV reports injected to listener
+	uint32_t skipped = 0;      // number of records which are not supported ADV reports
+	uint32_t parseMicros = 0;  // time spent by reading and parsing of capture
+	uint32_t injectMicros = 0; // time spent by injecting of ADV reports (address lookup + ring buffer)
+	uint32_t decodeMicros = 0; // time spent in bleAdvListener.process() (decoding + callbacks)
+	uint32_t lagMaxMicros = 0; // max. delay of injected report against its capture time
+	uint32_t durationMillis = 0; // duration of whole run
+	bool     finished = false;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Replays captured BLE ADV traffic to BleAdvListener (initialised by initInject())
+ * with original timing. Supported captures are btsnoop (HCI H4 or un-encapsulated HCI) and pcap
+ * (HCI H4, HCI H4 with pseudo header and LE link layer with pseudo header).
+ */
+class BleAdvReplay
+{
+public:
+	/**
+	 * @brief Starts replay of capture
+	 * @param[in] stream Stream with capture (e.g. file from SD card or SPIFFS)
+	 * @param[in] speed Replay speed multiplier (1 = original timing, 10 = 10x faster, 0 = as fast as possible)
+	 * @return Returns true if capture format was recognised
+	 */
+	bool begin( Stream *stream, uint16_t speed = 1 );
+
+	/**
+	 * @brief Replays packets which are due - should be called in every loop() iteration instead of bleAdvListener.process()
+	 * @return Returns false when replay is finished
+	 */
+	bool process();
+
+	/**
+	 * @brief Returns statistics of replay run
+	 * @return Returns actual statistics (final, when finished flag is set)
+	 */
+	const BleAdvReplayStats &getStats()
+	{
+		return stats;
+	}
+
+private:
+	enum
+	{
+		FMT_BTSNOOP,
+		FMT_PCAP,
+	} format;
+
+	Stream   *stream = nullptr;
+	uint16_t  speed = 1;
+	uint32_t  linkType = 0;       // btsnoop datalink type or pcap linktype
+	bool      bigEndian = false;  // pcap byte order
+	bool      nanoseconds = false; // pcap timestamp resolution
+
+	uint8_t   record[REPLAY_RECORD_MAX];
+	size_t    recordLength = 0;
+	uint64_t  recordTime = 0;      // capture time of buffered record in us
+	uint32_t  recordFlags = 0;     // btsnoop packet flags of buffered record
+	bool      recordValid = false;
+
+	uint64_t  firstTime = 0;       // capture time of first record
+	uint64_t  elapsedMicros = 0;   // time elapsed from start of replay
+	uint32_t  lastMicros = 0;
+	uint32_t  startMillis = 0;
+
+	BleAdvReplayStats stats;
+
+	/**
+	 * @brief Reads next record from capture to @record buffer
+	 * @return Returns false at the end of capture
+	 */
+	bool readRecord();
+
+	/**
+	 * @brief Reads 32 bit number from capture
+	 * @param[out] value Read value
+	 * @param[in] big true for big endian, false for little endian
+	 * @return Returns false at the end of capture
+	 */
+	bool read32( uint32_t *value, bool big );
+
+	/**
+	 * @brief Parses HCI event with LE advertising report and injects it to listener
+	 * @param[in] data HCI event (starting with event code)
+	 * @param[in] length Length of HCI event
+	 * @return Returns true if ADV report was injected
+	 */
+	bool injectHciEvent( const uint8_t *data, size_t length );
+
+	/**
+	 * @brief Parses LE link layer ADV packet and injects it to listener
+	 * @param[in] data Link layer packet (starting with access address)
+	 * @param[in] length Length of packet
+	 * @param[in] rssi RSSI of packet in dBm (ADV_RSSI_UNKNOWN if not captured)
+	 * @return Returns true if ADV report was injected
+	 */
+	bool injectLinkLayer( const uint8_t *data, size_t length, int8_t rssi );
+
+	/**
+	 * @brief Injects ADV report to listener
+	 * @param[in] addressLE Device address in little endian order (as sent over the air)
+	 * @param[in] payload ADV payload
+	 * @param[in] payloadLength Length of ADV payload
+	 * @param[in] rssi RSSI of report in dBm (ADV_RSSI_UNKNOWN if not captured)
+	 */
+	void inject( const uint8_t *addressLE, const uint8_t *payload, size_t payloadLength, int8_t rssi );
+
+	/**
+	 * @brief Injects buffered record according to capture format
+	 */
+	void injectRecord();
+};
+
+/* ************************************************************************** */
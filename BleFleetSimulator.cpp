@@ -0,0 +1,336 @@
+#include "BleFleetSimulator.h"
+#include "LYWSD03MMC.h"
+#include "LYWSDCGQ.h"
+#include "debug.h"
+
+/* ************************************************************************** */
+
+// bind key shared by all simulated sensors with encrypted frames
+static const uint8_t simKey[16] = { 0x53, 0x49, 0x4d, 0x2d, 0x4b, 0x45, 0x59, 0x2d, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37 };
+
+/* ************************************************************************** */
+/**
+ * @brief Creates simulated sensors and registers them to lywsd03mmc and lywsdcgq
+ * (they must be initialised before, lywsd03mmc with refreshTime = 0 - virtual sensors can't be connected)
+ * @param[in] config Configuration of simulated fleet
+ */
+void BleFleetSimulator::init( const FleetSimConfig &config )
+{
+	this->config = config;
+
+	count = config.atc1441Count + config.pvvxCount + config.encryptedCount + config.lywsdcgqCount;
+	sensors = new SimSensor[count];
+
+	mbedtls_ccm_init( &ccm );
+	mbedtls_ccm_setkey( &ccm, MBEDTLS_CIPHER_ID_AES, simKey, 16 * 8 );
+
+	for( uint32_t i = 0; i < count; i++ )
+	{
+		SimSensor &sensor = sensors[i];
+		uint32_t   n = i;
+
+		if( n < config.atc1441Count )
+		{
+			sensor.format = SIM_ATC1441;
+		}
+		else if( (n -= config.atc1441Count) < config.pvvxCount )
+		{
+			sensor.format = SIM_PVVX;
+		}
+		else if( (n -= config.pvvxCount) < config.encryptedCount )
+		{
+			sensor.format = SIM_ENCRYPTED;
+		}
+		else
+		{
+			sensor.format = SIM_LYWSDCGQ;
+		}
+
+		// OUI of real sensors, index of sensor in the rest of address
+		uint8_t mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, (uint8_t) (i >> 16), (uint8_t) (i >> 8), (uint8_t) i };
+
+		if( sensor.format == SIM_LYWSDCGQ )
+		{
+			mac[0] = 0x58;
+			mac[1] = 0x2D;
+			mac[2] = 0x34;
+		}
+
+		sensor.address = new BLEAddress( mac );
+		sensor.counter = (uint8_t) random( 256 );
+		sensor.temp = 18.0 + random( 80 ) / 10.0;
+		sensor.humidity = 35.0 + random( 300 ) / 10.0;
+		sensor.bat = 50 + random( 50 );
+
+		if( sensor.format == SIM_LYWSDCGQ )
+		{
+			lywsdcgq.deviceRegister( sensor.address );
+		}
+		else
+		{
+			lywsd03mmc.deviceRegister( sensor.address, nullptr, sensor.format == SIM_ENCRYPTED ? simKey : nullptr );
+		}
+	}
+
+	if( count && config.advRate > 0.0 )
+	{
+		advPeriodMicros = (uint32_t) (1000000.0 / (config.advRate * count));
+	}
+
+	elapsedMicros = 0;
+	nextAdvMicros = 0;
+	lastMicros = micros();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Builds ADV payload with actual values of sensor
+ * @param[in] sensor Simulated sensor
+ * @param[out] payload Buffer for ADV payload (at least 31 bytes)
+ * @return Returns length of payload
+ */
+size_t BleFleetSimulator::buildPayload( SimSensor &sensor, uint8_t *payload )
+{
+	const uint8_t *mac = *sensor.address->getNative();
+	uint8_t       *sd = payload + 4; // service data after AD length, AD type and UUID
+	size_t         sdLength = 0;
+	uint16_t       uuid = 0xFE95;
+
+	int16_t  temp10 = (int16_t) (sensor.temp * 10);
+	uint16_t humidity10 = (uint16_t) (sensor.humidity * 10);
+
+	switch( sensor.format )
+	{
+		case SIM_ATC1441 :
+		{
+			// MAC, temp (BE, 0.1 C), humidity (%), battery (%), voltage (BE, mV), frame counter
+			uint16_t mV = 2100 + sensor.bat * 10;
+
+			uuid = 0x181A;
+			memcpy( sd, mac, 6 );
+			sd[6] = temp10 >> 8;
+			sd[7] = temp10 & 0xFF;
+			sd[8] = (uint8_t) sensor.humidity;
+			sd[9] = (uint8_t) sensor.bat;
+			sd[10] = mV >> 8;
+			sd[11] = mV & 0xFF;
+			sd[12] = sensor.counter;
+			sdLength = 13;
+		}
+		break;
+
+		case SIM_PVVX :
+		{
+			// MAC (LE), temp (LE, 0.01 C), humidity (LE, 0.01 %), voltage (LE, mV), battery (%), frame counter, flags
+			int16_t  temp100 = (int16_t) (sensor.temp * 100);
+			uint16_t humidity100 = (uint16_t) (sensor.humidity * 100);
+			uint16_t mV = 2100 + sensor.bat * 10;
+
+			uuid = 0x181A;
+
+			for( int i = 0; i < 6; i++ )
+			{
+				sd[i] = mac[5 - i];
+			}
+
+			sd[6] = temp100 & 0xFF;
+			sd[7] = temp100 >> 8;
+			sd[8] = humidity100 & 0xFF;
+			sd[9] = humidity100 >> 8;
+			sd[10] = mV & 0xFF;
+			sd[11] = mV >> 8;
+			sd[12] = (uint8_t) sensor.bat;
+			sd[13] = sensor.counter;
+			sd[14] = 0;
+			sdLength = 15;
+		}
+		break;
+
+		case SIM_LYWSDCGQ :
+		case SIM_ENCRYPTED :
+		{
+			// MiBeacon: frame control, product id, frame counter, MAC (LE), object (id, length, value)
+			uint8_t object[7];
+			size_t  objectLength;
+
+			// real sensors send objects in turns
+			switch( sensor.counter & 0x03 )
+			{
+				case 0 :
+				{
+					object[0] = 0x04;
+					object[2] = 2;
+					object[3] = temp10 & 0xFF;
+					object[4] = temp10 >> 8;
+				}
+				break;
+
+				case 1 :
+				{
+					object[0] = 0x06;
+					object[2] = 2;
+					object[3] = humidity10 & 0xFF;
+					object[4] = humidity10 >> 8;
+				}
+				break;
+
+				case 2 :
+				{
+					object[0] = 0x0A;
+					object[2] = 1;
+					object[3] = (uint8_t) sensor.bat;
+				}
+				break;
+
+				default :
+				{
+					if( sensor.format == SIM_LYWSDCGQ )
+					{
+						object[0] = 0x0D;
+						object[2] = 4;
+						object[3] = temp10 & 0xFF;
+						object[4] = temp10 >> 8;
+						object[5] = humidity10 & 0xFF;
+						object[6] = humidity10 >> 8;
+					}
+					else
+					{
+						// LYWSD03MMC doesn't send combined object
+						object[0] = 0x04;
+						object[2] = 2;
+						object[3] = temp10 & 0xFF;
+						object[4] = temp10 >> 8;
+					}
+				}
+				break;
+			}
+
+			object[1] = 0x10;
+			objectLength = 3 + object[2];
+
+			if( sensor.format == SIM_LYWSDCGQ )
+			{
+				sd[0] = 0x50;
+				sd[1] = 0x20;
+				sd[2] = 0xAA;
+				sd[3] = 0x01;
+			}
+			else
+			{
+				sd[0] = 0x58;
+				sd[1] = 0x58;
+				sd[2] = 0x5B;
+				sd[3] = 0x05;
+			}
+
+			sd[4] = sensor.counter;
+
+			for( int i = 0; i < 6; i++ )
+			{
+				sd[5 + i] = mac[5 - i];
+			}
+
+			if( sensor.format == SIM_LYWSDCGQ )
+			{
+				memcpy( sd + 11, object, objectLength );
+				sdLength = 11 + objectLength;
+			}
+			else
+			{
+				// encrypted object, 3 bytes of extended counter, 4 bytes of MIC
+				const unsigned char authData = 0x11;
+				uint8_t *extCounter = sd + 11 + objectLength;
+				uint8_t  iv[12];
+
+				extCounter[0] = 0;
+				extCounter[1] = 0;
+				extCounter[2] = 0;
+
+				memcpy( iv, sd + 5, 6 );
+				memcpy( iv + 6, sd + 2, 3 );
+				memcpy( iv + 9, extCounter, 3 );
+
+				uint32_t start = micros();
+
+				mbedtls_ccm_encrypt_and_tag( &ccm, objectLength, iv, 12, &authData, 1,
+						object, sd + 11, extCounter + 3, 4 );
+
+				stats.encryptMicros += micros() - start;
+				sdLength = 11 + objectLength + 3 + 4;
+			}
+		}
+		break;
+	}
+
+	payload[0] = 3 + sdLength;
+	payload[1] = BLE_AD_TYPE_SERVICE_DATA;
+	payload[2] = uuid & 0xFF;
+	payload[3] = uuid >> 8;
+
+	return 4 + sdLength;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Generates ADV packets which are due - should be called in every loop() iteration instead of bleAdvListener.process()
+ */
+void BleFleetSimulator::process()
+{
+	if( count == 0 || advPeriodMicros == 0 )
+	{
+		return;
+	}
+
+	uint32_t now = micros();
+
+	elapsedMicros += (uint32_t) (now - lastMicros);
+	lastMicros = now;
+
+	for( int i = 0; i < SIM_BATCH_MAX && nextAdvMicros <= elapsedMicros; i++ )
+	{
+		SimSensor &sensor = sensors[next];
+		uint8_t    payload[31];
+
+		next = (next + 1) % count;
+		nextAdvMicros += advPeriodMicros;
+
+		// new measurement with small change of values
+		sensor.counter++;
+		sensor.temp += (random( 5 ) - 2) / 10.0;
+		sensor.humidity += (random( 5 ) - 2) / 10.0;
+		sensor.temp = constrain( sensor.temp, -10.0, 50.0 );
+		sensor.humidity = constrain( sensor.humidity, 0.0, 99.0 );
+
+		size_t length = buildPayload( sensor, payload );
+
+		stats.generated++;
+
+		if( (long) random( 100 ) < config.lossPercent )
+		{
+			stats.lost++;
+			continue;
+		}
+
+		int copies = 1;
+
+		if( (long) random( 100 ) < config.duplicatePercent )
+		{
+			stats.duplicated++;
+			copies = 2;
+		}
+
+		for( int c = 0; c < copies; c++ )
+		{
+			bleAdvListener.injectAdv( *sensor.address->getNative(), payload, length );
+			stats.injected++;
+
+			uint32_t start = micros();
+
+			bleAdvListener.process();
+
+			stats.decodeMicros += micros() - start;
+		}
+	}
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Arduino.h"
+#include "BleAdvListener.h"
+#include "mbedtls/ccm.h"
+
+/* ************************************************************************** */
+
+#define SIM_BATCH_MAX  64 // max. number of ADV packets generated in one process() call
+
+/* ************************************************************************** */
+/**
+ * @brief Configuration of simulated sensor fleet
+ */
+struct FleetSimConfig
+{
+	uint16_t atc1441Count = 0;    // LYWSD03MMC sensors with atc1441 firmware (0x181A, 13 bytes)
+	uint16_t pvvxCount = 0;       // LYWSD03MMC sensors with pvvx firmware (0x181A, 15 bytes)
+	uint16_t encryptedCount = 0;  // LYWSD03MMC sensors with stock firmware (0xFE95, encrypted 0x5858 frames)
+	uint16_t lywsdcgqCount = 0;   // LYWSDCGQ sensors (0xFE95, plain 0x5020 frames)
+	float    advRate = 1.0;       // ADV packets per second sent by one sensor
+	uint8_t  lossPercent = 0;     // percentage of lost ADV packets
+	uint8_t  duplicatePercent = 0; // percentage of ADV packets which are received twice
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Statistics of simulation
+ */
+struct FleetSimStats
+{
+	uint32_t generated = 0;   // number of generated frames
+	uint32_t lost = 0;        // number of frames not injected (simulated loss)
+	uint32_t duplicated = 0;  // number of frames injected twice
+	uint32_t injected = 0;    // number of injected ADV packets
+	uint32_t encryptMicros = 0; // time spent by encryption of frames
+	uint32_t decodeMicros = 0;  // time spent in bleAdvListener.process() (decoding + callbacks)
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Simulates fleet of LYWSD03MMC and LYWSDCGQ sensors sending ADV packets with the same
+ * format as real sensors. Packets are injected to BleAdvListener initialised by initInject().
+ */
+class BleFleetSimulator
+{
+public:
+	/**
+	 * @brief Creates simulated sensors and registers them to lywsd03mmc and lywsdcgq
+	 * (they must be initialised before, lywsd03mmc with refreshTime = 0 - virtual sensors can't be connected)
+	 * @param[in] config Configuration of simulated fleet
+	 */
+	void init( const FleetSimConfig &config );
+
+	/**
+	 * @brief Generates ADV packets which are due - should be called in every loop() iteration instead of bleAdvListener.process()
+	 */
+	void process();
+
+	/**
+	 * @brief Returns statistics of simulation
+	 * @return Returns actual statistics
+	 */
+	const FleetSimStats &getStats()
+	{
+		return stats;
+	}
+
+private:
+	enum SimFormat : uint8_t
+	{
+		SIM_ATC1441,
+		SIM_PVVX,
+		SIM_ENCRYPTED,
+		SIM_LYWSDCGQ,
+	};
+
+	/**
+	 * @brief One simulated sensor
+	 */
+	struct SimSensor
+	{
+		BLEAddress *address;
+		SimFormat   format;
+		uint8_t     counter;
+		float       temp;
+		float       humidity;
+		float       bat;
+	};
+
+	FleetSimConfig config;
+	FleetSimStats  stats;
+
+	SimSensor     *sensors = nullptr;
+	uint32_t       count = 0;
+	uint32_t       next = 0;           // index of sensor which sends next packet
+
+	mbedtls_ccm_context ccm;           // all encrypted sensors share one key
+
+	uint64_t       elapsedMicros = 0;  // time elapsed from init()
+	uint32_t       lastMicros = 0;
+	uint64_t       nextAdvMicros = 0;  // time of next ADV packet
+	uint32_t       advPeriodMicros = 0; // period of ADV packets of whole fleet
+
+	/**
+	 * @brief Builds ADV payload with actual values of sensor
+	 * @param[in] sensor Simulated sensor
+	 * @param[out] payload Buffer for ADV payload (at least 31 bytes)
+	 * @return Returns length of payload
+	 */
+	size_t buildPayload( SimSensor &sensor, uint8_t *payload );
+};
+
+/* ************************************************************************** */
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "Arduino.h"
+#include <BLEAddress.h>
+
+/* ************************************************************************** */
+/*
+ * Thin transport interface between gateway core and BLE stack. Core (listener, sensor classes)
+ * works only with these classes - ESP32 BLE library is one backend (BleTransportEsp32.h),
+ * in-process fake used by native host build is another one (host/BleTransportFake.h).
+ * Address type is BLEAddress - on host it is provided by host platform with the same interface.
+ */
+
+#define ADV_RSSI_UNKNOWN  127 // RSSI is not available (e.g. injected packet without RSSI)
+
+/* ************************************************************************** */
+/**
+ * @brief Callback used to receive ADV reports from scanner (called from BT task)
+ */
+class BleScannerCbk
+{
+public:
+	virtual ~BleScannerCbk() {}
+
+	/**
+	 * @brief Method called for every received ADV report
+	 * @param[in] mac Address of device which sent the packet
+	 * @param[in] payload Raw ADV payload (AD structures, scan response is appended)
+	 * @param[in] payloadLength Length of raw ADV payload
+	 * @param[in] rssi RSSI of packet in dBm (ADV_RSSI_UNKNOWN if not available)
+	 */
+	virtual void onAdvReport( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi ) = 0;
+
+	/**
+	 * @brief Method called when scan is finished - its duration expired, it was stopped or it failed to start
+	 */
+	virtual void onScanComplete() = 0;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Passive scanner of ADV packets
+ */
+class BleScanner
+{
+public:
+	virtual ~BleScanner() {}
+
+	/**
+	 * @brief Sets callback which receives ADV reports and scan completion
+	 * @param[in] cbk Pointer to callback class
+	 */
+	virtual void setCbk( BleScannerCbk *cbk ) = 0;
+
+	/**
+	 * @brief Starts passive scan. End of scan is reported by onScanComplete().
+	 * @param[in] interval Scan interval in ms
+	 * @param[in] window Scan window in ms
+	 * @param[in] duration Duration of scan in seconds (0 = scan until stopped)
+	 * @return Returns false if scan couldn't be started (onScanComplete() is not called then)
+	 */
+	virtual bool start( uint16_t interval, uint16_t window, uint32_t duration ) = 0;
+
+	/**
+	 * @brief Stops running scan - stop is asynchronous, it is finished when onScanComplete() is called
+	 */
+	virtual void stop() = 0;
+
+	/**
+	 * @brief Returns information if scan can run without time limit
+	 * @return Returns true if start() with duration 0 is supported
+	 */
+	virtual bool canRunContinuous() = 0;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Callback used to receive GATT events of one client (called from BT task)
+ */
+class BleGattClientCbk
+{
+public:
+	virtual ~BleGattClientCbk() {}
+
+	/**
+	 * @brief Method called when notification is received
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] data Value of characteristic
+	 * @param[in] length Length of value
+	 */
+	virtual void onNotify( uint16_t handle, const uint8_t *data, size_t length ) = 0;
+
+	/**
+	 * @brief Method called when read requested by read() is finished
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] ok true if read succeeded, false if it was answered with error
+	 * @param[in] data Value of characteristic
+	 * @param[in] length Length of value
+	 */
+	virtual void onRead( uint16_t handle, bool ok, const uint8_t *data, size_t length ) = 0;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief GATT client of one connection. Connect, disconnect and discovery are blocking,
+ * read, writes and notifications are asynchronous and they are processed by remote device in order.
+ */
+class BleGattClient
+{
+public:
+	virtual ~BleGattClient() {}
+
+	/**
+	 * @brief Sets callback which receives notifications and read results
+	 * @param[in] cbk Pointer to callback class
+	 */
+	virtual void setCbk( BleGattClientCbk *cbk ) = 0;
+
+	/**
+	 * @brief Connects to device (blocking)
+	 * @param[in] address Address of device
+	 * @return Returns true if connection was established
+	 */
+	virtual bool connect( BLEAddress &address ) = 0;
+
+	/**
+	 * @brief Disconnects from device (blocking)
+	 */
+	virtual void disconnect() = 0;
+
+	/**
+	 * @brief Returns information if client is connected
+	 * @return Returns true if connection is established
+	 */
+	virtual bool isConnected() = 0;
+
+	/**
+	 * @brief Finds characteristic of remote service - first call in connection runs service discovery (blocking)
+	 * @param[in] serviceUUID UUID of service
+	 * @param[in] charUUID UUID of characteristic
+	 * @param[out] handle Handle of characteristic
+	 * @param[out] cccdHandle Handle of client characteristic configuration descriptor (0 = characteristic doesn't have it)
+	 * @return Returns true if characteristic was found
+	 */
+	virtual bool findCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t *handle, uint16_t *cccdHandle = nullptr ) = 0;
+
+	/**
+	 * @brief Requests read of characteristic - result is reported by onRead()
+	 * @param[in] handle Handle of characteristic
+	 * @return Returns true if request was sent
+	 */
+	virtual bool read( uint16_t handle ) = 0;
+
+	/**
+	 * @brief Writes characteristic (write request)
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] data Value to write
+	 * @param[in] length Length of value
+	 * @return Returns true if request was sent
+	 */
+	virtual bool write( uint16_t handle, const uint8_t *data, size_t length ) = 0;
+
+	/**
+	 * @brief Writes descriptor (write request)
+	 * @param[in] handle Handle of descriptor
+	 * @param[in] data Value to write
+	 * @param[in] length Length of value
+	 * @return Returns true if request was sent
+	 */
+	virtual bool writeDescriptor( uint16_t handle, const uint8_t *data, size_t length ) = 0;
+
+	/**
+	 * @brief Registers notifications of characteristic in local stack (CCCD of device must be written too)
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] doRegister true for register, false for unregister
+	 * @return Returns true on success
+	 */
+	virtual bool registerNotify( uint16_t handle, bool doRegister ) = 0;
+
+	/**
+	 * @brief Requests change of connection parameters
+	 * @param[in] minInterval Min. connection interval in 1.25ms units
+	 * @param[in] maxInterval Max. connection interval in 1.25ms units
+	 * @param[in] latency Slave latency in connection events
+	 * @param[in] timeout Supervision timeout in 10ms units
+	 * @return Returns true if request was sent
+	 */
+	virtual bool updateConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout ) = 0;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Factory of scanners and GATT clients of one BLE stack
+ */
+class BleTransport
+{
+public:
+	virtual ~BleTransport() {}
+
+	/**
+	 * @brief Creates scanner
+	 * @param[in] rawMode true for scanner processing ADV packets directly from stack events (if backend has it)
+	 * @return Returns new scanner
+	 */
+	virtual BleScanner *createScanner( bool rawMode ) = 0;
+
+	/**
+	 * @brief Creates GATT client (BLE stack must be already initialised)
+	 * @return Returns new client
+	 */
+	virtual BleGattClient *createGattClient() = 0;
+};
+
+/* ************************************************************************** */
+
+extern BleTransport *bleTransport; // transport used by default init() of listener and sensor classes (set by backend)
+
+/* ************************************************************************** */
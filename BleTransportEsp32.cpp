@@ -0,0 +1,498 @@
+#include "BleTransportEsp32.h"
+
+#include <BLEUtils.h>
+#include <BLEScan.h>
+#include <BLEAdvertisedDevice.h>
+#include "debug.h"
+
+/* ************************************************************************** */
+
+BleTransportEsp32 bleTransportEsp32;
+
+BleTransport *bleTransport = &bleTransportEsp32;
+
+BleScannerCbk *BleScannerEsp32::cbk = nullptr;
+BleScannerCbk *BleScannerEsp32Raw::cbk = nullptr;
+
+BleGattClientEsp32 *BleGattClientEsp32::clients[BLE_ESP32_CLIENTS_MAX];
+uint8_t             BleGattClientEsp32::clientCount = 0;
+
+/* ************************************************************************** */
+/**
+ * @brief Dummy client callbacks - does nothing but is needed for notifications to work
+ */
+class DummyClientCallback : public BLEClientCallbacks
+{
+	void onConnect( BLEClient* pclient )
+	{
+	}
+
+	void onDisconnect( BLEClient* pclient )
+	{
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Class for receiving ADV packets from BLEScan and forwarding them to scanner callback
+ */
+class BleAdvertisedDeviceCbk : public BLEAdvertisedDeviceCallbacks
+{
+	void onResult( BLEAdvertisedDevice advertisedDevice )
+	{
+		BLEAddress address = advertisedDevice.getAddress();
+
+		if( BleScannerEsp32::cbk != nullptr )
+		{
+			BleScannerEsp32::cbk->onAdvReport( *address.getNative(), advertisedDevice.getPayload(), advertisedDevice.getPayloadLength(),
+					advertisedDevice.haveRSSI() ? advertisedDevice.getRSSI() : ADV_RSSI_UNKNOWN );
+		}
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Creates scanner
+ * @param[in] scan BLE scan object (nullptr = scan object of BLEDevice)
+ */
+BleScannerEsp32::BleScannerEsp32( BLEScan *scan )
+{
+	pBLEScan = scan ? scan : BLEDevice::getScan();
+
+	pBLEScan->setAdvertisedDeviceCallbacks( new BleAdvertisedDeviceCbk(), true );
+	pBLEScan->setActiveScan( false );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets callback which receives ADV reports and scan completion
+ * @param[in] cbk Pointer to callback class
+ */
+void BleScannerEsp32::setCbk( BleScannerCbk *cbk )
+{
+	BleScannerEsp32::cbk = cbk;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Starts passive scan. End of scan is reported by onScanComplete().
+ * @param[in] interval Scan interval in ms
+ * @param[in] window Scan window in ms
+ * @param[in] duration Duration of scan in seconds
+ * @return Returns false if scan couldn't be started
+ */
+bool BleScannerEsp32::start( uint16_t interval, uint16_t window, uint32_t duration )
+{
+	pBLEScan->setInterval( interval );
+	pBLEScan->setWindow( window );
+
+	return pBLEScan->start( duration, scanCompleteCbk, false );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Stops running scan
+ */
+void BleScannerEsp32::stop()
+{
+	pBLEScan->stop();
+
+	// BLEScan doesn't call completion callback when it is stopped
+	scanCompleteCbk( BLEScanResults() );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Callback called by BLEScan when scan is finished
+ * @param[in] foundDevices Results from scanning
+ */
+void BleScannerEsp32::scanCompleteCbk( BLEScanResults foundDevices )
+{
+	if( cbk != nullptr )
+	{
+		cbk->onScanComplete();
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Creates scanner - GAP handler is registered, BLEScan ignores scan results when it didn't start scanning itself
+ */
+BleScannerEsp32Raw::BleScannerEsp32Raw()
+{
+	// the same parameters as BLEScan would use
+	scanParams.scan_type          = BLE_SCAN_TYPE_PASSIVE;
+	scanParams.own_addr_type      = BLE_ADDR_TYPE_PUBLIC;
+	scanParams.scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL;
+	scanParams.scan_duplicate     = BLE_SCAN_DUPLICATE_DISABLE;
+
+	BLEDevice::setCustomGapHandler( gapEventCbk );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets callback which receives ADV reports and scan completion
+ * @param[in] cbk Pointer to callback class
+ */
+void BleScannerEsp32Raw::setCbk( BleScannerCbk *cbk )
+{
+	BleScannerEsp32Raw::cbk = cbk;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Starts passive scan. End of scan is reported by onScanComplete().
+ * @param[in] interval Scan interval in ms
+ * @param[in] window Scan window in ms
+ * @param[in] duration Duration of scan in seconds (0 = scan until stopped)
+ * @return Returns false if scan couldn't be started
+ */
+bool BleScannerEsp32Raw::start( uint16_t interval, uint16_t window, uint32_t duration )
+{
+	// interval and window in units of 0.625 ms
+	scanParams.scan_interval = (uint16_t) (interval / 0.625);
+	scanParams.scan_window   = (uint16_t) (window / 0.625);
+
+	return esp_ble_gap_set_scan_params( &scanParams ) == ESP_OK && esp_ble_gap_start_scanning( duration ) == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Stops running scan - stop is finished by ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT
+ */
+void BleScannerEsp32Raw::stop()
+{
+	esp_ble_gap_stop_scanning();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief GAP event handler - ADV packets are passed to callback directly from BT stack buffer
+ * @param[in] event GAP event type
+ * @param[in] param GAP event parameters
+ */
+void BleScannerEsp32Raw::gapEventCbk( esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param )
+{
+	if( cbk == nullptr )
+	{
+		return;
+	}
+
+	switch( event )
+	{
+		case ESP_GAP_BLE_SCAN_RESULT_EVT :
+		{
+			if( param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT )
+			{
+				cbk->onScanComplete();
+			}
+			else if( param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT )
+			{
+				cbk->onAdvReport( param->scan_rst.bda, param->scan_rst.ble_adv,
+						param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len, param->scan_rst.rssi );
+			}
+		}
+		break;
+
+		case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT :
+		{
+			if( param->scan_start_cmpl.status != ESP_BT_STATUS_SUCCESS )
+			{
+				SERIAL_PRINTF("Failed to start scan, status %d\n", param->scan_start_cmpl.status );
+				cbk->onScanComplete();
+			}
+		}
+		break;
+
+		case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT :
+		{
+			cbk->onScanComplete();
+		}
+		break;
+
+		default:
+		break;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Creates client
+ * @param[in] client BLE client of library (nullptr = new client is created)
+ */
+BleGattClientEsp32::BleGattClientEsp32( BLEClient *client )
+{
+	if( client == nullptr )
+	{
+		client = BLEDevice::createClient();
+		client->setClientCallbacks( new DummyClientCallback() );
+	}
+
+	this->client = client;
+
+	memset( peer, 0, sizeof( peer ) );
+
+	if( clientCount < BLE_ESP32_CLIENTS_MAX )
+	{
+		clients[clientCount++] = this;
+	}
+
+	BLEDevice::setCustomGattcHandler( gattcEventCbk );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets callback which receives notifications and read results
+ * @param[in] cbk Pointer to callback class
+ */
+void BleGattClientEsp32::setCbk( BleGattClientCbk *cbk )
+{
+	this->cbk = cbk;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Connects to device (blocking)
+ * @param[in] address Address of device
+ * @return Returns true if connection was established
+ */
+bool BleGattClientEsp32::connect( BLEAddress &address )
+{
+	memcpy( peer, *address.getNative(), sizeof( esp_bd_addr_t ) );
+
+	return client->connect( address );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Disconnects from device (blocking)
+ */
+void BleGattClientEsp32::disconnect()
+{
+	client->disconnect();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Returns information if client is connected
+ * @return Returns true if connection is established
+ */
+bool BleGattClientEsp32::isConnected()
+{
+	return client->isConnected();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Finds characteristic of remote service - first call in connection runs service discovery (blocking)
+ * @param[in] serviceUUID UUID of service
+ * @param[in] charUUID UUID of characteristic
+ * @param[out] handle Handle of characteristic
+ * @param[out] cccdHandle Handle of client characteristic configuration descriptor (0 = characteristic doesn't have it)
+ * @return Returns true if characteristic was found
+ */
+bool BleGattClientEsp32::findCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t *handle, uint16_t *cccdHandle )
+{
+	BLERemoteService        *remService;
+	BLERemoteCharacteristic *remCharacteristic;
+	BLERemoteDescriptor     *remDescriptor;
+
+	if( client->isConnected() == false )
+	{
+		return false;
+	}
+
+	// characteristics of service are retrieved only once - next calls don't start another discovery
+	if( (remService = client->getService( BLEUUID( serviceUUID ) )) == nullptr )
+	{
+		SERIAL_PRINTLN("Failed to get service");
+		return false;
+	}
+
+	if( (remCharacteristic = remService->getCharacteristic( BLEUUID( charUUID ) )) == nullptr )
+	{
+		SERIAL_PRINTLN("Failed to get characteristic");
+		return false;
+	}
+
+	*handle = remCharacteristic->getHandle();
+
+	if( cccdHandle != nullptr )
+	{
+		remDescriptor = remCharacteristic->getDescriptor( BLEUUID( (uint16_t) 0x2902 ) );
+		*cccdHandle = remDescriptor ? remDescriptor->getHandle() : 0;
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Requests read of characteristic - result is reported by onRead()
+ * @param[in] handle Handle of characteristic
+ * @return Returns true if request was sent
+ */
+bool BleGattClientEsp32::read( uint16_t handle )
+{
+	return esp_ble_gattc_read_char( client->getGattcIf(), client->getConnId(), handle, ESP_GATT_AUTH_REQ_NONE ) == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Writes characteristic (write request)
+ * @param[in] handle Handle of characteristic
+ * @param[in] data Value to write
+ * @param[in] length Length of value
+ * @return Returns true if request was sent
+ */
+bool BleGattClientEsp32::write( uint16_t handle, const uint8_t *data, size_t length )
+{
+	return esp_ble_gattc_write_char( client->getGattcIf(), client->getConnId(), handle, length, (uint8_t *) data,
+			ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE ) == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Writes descriptor (write request)
+ * @param[in] handle Handle of descriptor
+ * @param[in] data Value to write
+ * @param[in] length Length of value
+ * @return Returns true if request was sent
+ */
+bool BleGattClientEsp32::writeDescriptor( uint16_t handle, const uint8_t *data, size_t length )
+{
+	return esp_ble_gattc_write_char_descr( client->getGattcIf(), client->getConnId(), handle, length, (uint8_t *) data,
+			ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE ) == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Registers notifications of characteristic in local stack
+ * @param[in] handle Handle of characteristic
+ * @param[in] doRegister true for register, false for unregister
+ * @return Returns true on success
+ */
+bool BleGattClientEsp32::registerNotify( uint16_t handle, bool doRegister )
+{
+	esp_err_t err;
+
+	if( doRegister )
+	{
+		err = esp_ble_gattc_register_for_notify( client->getGattcIf(), peer, handle );
+	}
+	else
+	{
+		err = esp_ble_gattc_unregister_for_notify( client->getGattcIf(), peer, handle );
+	}
+
+	return err == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Requests change of connection parameters by GAP connection parameter update
+ * @param[in] minInterval Min. connection interval in 1.25ms units
+ * @param[in] maxInterval Max. connection interval in 1.25ms units
+ * @param[in] latency Slave latency in connection events
+ * @param[in] timeout Supervision timeout in 10ms units
+ * @return Returns true if request was sent
+ */
+bool BleGattClientEsp32::updateConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout )
+{
+	esp_ble_conn_update_params_t update;
+
+	memcpy( update.bda, peer, sizeof( esp_bd_addr_t ) );
+	update.min_int = minInterval;
+	update.max_int = maxInterval;
+	update.latency = latency;
+	update.timeout = timeout;
+
+	return esp_ble_gap_update_conn_params( &update ) == ESP_OK;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Finds client by GATT client interface and connection id (called from BT task)
+ * @param[in] gattc_if GATT client interface
+ * @param[in] connId Connection id
+ * @return Returns connected client or nullptr if there is no such client
+ */
+BleGattClientEsp32 *BleGattClientEsp32::findClient( esp_gatt_if_t gattc_if, uint16_t connId )
+{
+	for( uint8_t i = 0; i < clientCount; i++ )
+	{
+		BLEClient *client = clients[i]->client;
+
+		if( client->isConnected() && client->getGattcIf() == gattc_if && client->getConnId() == connId )
+		{
+			return clients[i];
+		}
+	}
+
+	return nullptr;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Callback called for every GATT client event of BT stack (called from BT task)
+ * @param[in] event Type of event
+ * @param[in] gattc_if GATT client interface of event
+ * @param[in] param Event parameters
+ */
+void BleGattClientEsp32::gattcEventCbk( esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param )
+{
+	BleGattClientEsp32 *client;
+
+	// BLERemoteCharacteristic objects are not needed - data are routed by interface, connection id and handle
+	switch( event )
+	{
+		case ESP_GATTC_NOTIFY_EVT :
+		{
+			if( (client = findClient( gattc_if, param->notify.conn_id )) != nullptr && client->cbk != nullptr )
+			{
+				client->cbk->onNotify( param->notify.handle, param->notify.value, param->notify.value_len );
+			}
+		}
+		break;
+
+		case ESP_GATTC_READ_CHAR_EVT :
+		{
+			if( (client = findClient( gattc_if, param->read.conn_id )) != nullptr && client->cbk != nullptr )
+			{
+				client->cbk->onRead( param->read.handle, param->read.status == ESP_GATT_OK, param->read.value, param->read.value_len );
+			}
+		}
+		break;
+
+		default :
+			break;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Creates scanner
+ * @param[in] rawMode true for scanner processing ADV packets directly from GAP events
+ * @return Returns new scanner
+ */
+BleScanner *BleTransportEsp32::createScanner( bool rawMode )
+{
+	if( rawMode )
+	{
+		return new BleScannerEsp32Raw();
+	}
+
+	return new BleScannerEsp32();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Creates GATT client (BLE stack must be already initialised)
+ * @return Returns new client
+ */
+BleGattClient *BleTransportEsp32::createGattClient()
+{
+	return new BleGattClientEsp32();
+}
+
+/* ************************************************************************** */
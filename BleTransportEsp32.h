@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Arduino.h"
+#include "BleTransport.h"
+#include <BLEDevice.h>
+#include <esp_gap_ble_api.h>
+#include <esp_gattc_api.h>
+
+/* ************************************************************************** */
+
+#define BLE_ESP32_CLIENTS_MAX  4 // max. number of GATT clients whose events are routed by backend
+
+/* ************************************************************************** */
+/**
+ * @brief Scanner using BLEScan of ESP32 BLE library (BLEAdvertisedDevice is created for every packet)
+ */
+class BleScannerEsp32 : public BleScanner
+{
+public:
+	/**
+	 * @brief Creates scanner
+	 * @param[in] scan BLE scan object (nullptr = scan object of BLEDevice)
+	 */
+	BleScannerEsp32( BLEScan *scan = nullptr );
+
+	void setCbk( BleScannerCbk *cbk );
+	bool start( uint16_t interval, uint16_t window, uint32_t duration );
+	void stop();
+
+	/**
+	 * @brief BLEScan keeps list of all devices seen during scan, which would grow without limit
+	 */
+	bool canRunContinuous()
+	{
+		return false;
+	}
+
+private:
+	BLEScan       *pBLEScan;
+
+	static BleScannerCbk *cbk; // BLEScan calls plain functions, so there can be only one library scanner
+
+	static void scanCompleteCbk( BLEScanResults foundDevices );
+
+	friend class BleAdvertisedDeviceCbk;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Scanner processing ADV packets directly from GAP events of BT stack - packets are not parsed
+ * or allocated by library, which saves lot of CPU time in busy environment
+ */
+class BleScannerEsp32Raw : public BleScanner
+{
+public:
+	BleScannerEsp32Raw();
+
+	void setCbk( BleScannerCbk *cbk );
+	bool start( uint16_t interval, uint16_t window, uint32_t duration );
+	void stop();
+
+	bool canRunContinuous()
+	{
+		return true;
+	}
+
+private:
+	esp_ble_scan_params_t scanParams;
+
+	static BleScannerCbk *cbk; // GAP handler is plain function, so there can be only one raw scanner
+
+	static void gapEventCbk( esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param );
+};
+
+/* ************************************************************************** */
+/**
+ * @brief GATT client using BLEClient of ESP32 BLE library for connection and discovery. Reads, writes
+ * and notifications are done directly by cached handles, events are routed to client by GATT interface
+ * and connection id.
+ */
+class BleGattClientEsp32 : public BleGattClient
+{
+public:
+	/**
+	 * @brief Creates client
+	 * @param[in] client BLE client of library (nullptr = new client is created)
+	 */
+	BleGattClientEsp32( BLEClient *client = nullptr );
+
+	void setCbk( BleGattClientCbk *cbk );
+	bool connect( BLEAddress &address );
+	void disconnect();
+	bool isConnected();
+	bool findCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t *handle, uint16_t *cccdHandle = nullptr );
+	bool read( uint16_t handle );
+	bool write( uint16_t handle, const uint8_t *data, size_t length );
+	bool writeDescriptor( uint16_t handle, const uint8_t *data, size_t length );
+	bool registerNotify( uint16_t handle, bool doRegister );
+	bool updateConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout );
+
+private:
+	BLEClient        *client;
+	BleGattClientCbk *cbk = nullptr;
+	esp_bd_addr_t     peer;                 // address of connected device
+
+	static BleGattClientEsp32 *clients[BLE_ESP32_CLIENTS_MAX]; // clients whose events are routed
+	static uint8_t             clientCount;
+
+	static void gattcEventCbk( esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param );
+
+	/**
+	 * @brief Finds client by GATT client interface and connection id (called from BT task)
+	 * @param[in] gattc_if GATT client interface
+	 * @param[in] connId Connection id
+	 * @return Returns connected client or nullptr if there is no such client
+	 */
+	static BleGattClientEsp32 *findClient( esp_gatt_if_t gattc_if, uint16_t connId );
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Transport of ESP32 BLE library
+ */
+class BleTransportEsp32 : public BleTransport
+{
+public:
+	BleScanner *createScanner( bool rawMode );
+	BleGattClient *createGattClient();
+};
+
+/* ************************************************************************** */
+
+extern BleTransportEsp32 bleTransportEsp32;
+
+/* ************************************************************************** */
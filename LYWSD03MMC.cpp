@@ -1,65 +1,74 @@
 #include "LYWSD03MMC.h"
+#include "MiBeacon.h"
+#include "AdvParsers.h"
 #include "debug.h"
-#include "mbedtls/ccm.h"
+#include <algorithm>
 
 /* ************************************************************************** */
 
 // The remote service we wish to connect to.
-static BLEUUID serviceUUID("ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6");
+static const char *serviceUUID = "ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6";
 
 // The characteristic of the remote service we are interested in.
-static BLEUUID    charUUID("ebe0ccc1-7a0a-4b0c-8a1a-6ff2997da3a6");
+static const char *charUUID = "ebe0ccc1-7a0a-4b0c-8a1a-6ff2997da3a6";
 
 // Characteristic to set communication interval
-static BLEUUID charUUID_SetIntervalComm("ebe0ccd8-7a0a-4b0c-8a1a-6ff2997da3a6");
+static const char *charUUID_SetIntervalComm = "ebe0ccd8-7a0a-4b0c-8a1a-6ff2997da3a6";
 
-LYWSD03MMC lywsd03mmc;
+// Characteristics of history - range of stored records, index of first requested record and records itself
+static const char *charUUID_HistRange = "ebe0ccb9-7a0a-4b0c-8a1a-6ff2997da3a6";
+static const char *charUUID_HistIndex = "ebe0ccba-7a0a-4b0c-8a1a-6ff2997da3a6";
+static const char *charUUID_HistData = "ebe0ccbc-7a0a-4b0c-8a1a-6ff2997da3a6";
 
-/* ************************************************************************** */
-/**
- * @brief Dummy client callbacks - does nothing but is needed for notifications to work
- */
-class DummyClientCallback : public BLEClientCallbacks
-{
-	void onConnect( BLEClient* pclient )
-	{
-	}
+// Characteristic with sensor clock - timestamps of history records are by this clock
+static const char *charUUID_Time = "ebe0ccb7-7a0a-4b0c-8a1a-6ff2997da3a6";
 
-	void onDisconnect( BLEClient* pclient )
-	{
-	}
-};
+// Service and command characteristic of pvvx firmware - commands are written, responses are notified
+static const char *pvvxServiceUUID = "00001f10-0000-1000-8000-00805f9b34fb";
+static const char *pvvxCharUUID_Cmd = "00001f1f-0000-1000-8000-00805f9b34fb";
+
+#define PVVX_CMD_TIME  0x23 // response: id, time (u32)
+#define PVVX_CMD_LOG   0x35 // request: id, count (u16), skip (u16); response: records from the newest one, end is id, 0 (u16)
+
+LYWSD03MMC lywsd03mmc;
 
 /* ************************************************************************** */
 /**
  * @brief Decrypts encrypted ADV service data
  * @param[in] serviceData Received encrypted service data
- * @param[in] key Key to decrypt data
- * @param[out] decryptedData Decrypted data (if success)
+ * @param[out] decryptedData Decrypted MiBeacon objects (if success)
+ * @param[out] decryptedLength Length of decrypted objects
  * @return Returns true on success or false on failure
  */
-bool LYWSD03MMCData::decryptServiceData( std::string &serviceData, const uint8_t *key, uint8_t decryptedData[16] )
+bool LYWSD03MMCData::decryptServiceData( const AdvDataView &serviceData, uint8_t decryptedData[16], size_t *decryptedLength )
 {
-	const uint8_t *v = (const uint8_t *) serviceData.c_str();
+	const uint8_t *v = serviceData.data;
 
 	if( !(v[0] & 0x08) )
 	{
-		SERIAL_PRINTF("Payload of size %u is not encrypted\n", serviceData.length() );
+		SERIAL_PRINTF("Payload of size %u is not encrypted\n", serviceData.length );
+
+		int offset = MiBeacon::objectsOffset( v, serviceData.length );
+
+		if( offset < 0 )
+		{
+			return false;
+		}
 
-		uint8_t len = (uint8_t) serviceData.length();
-		serviceData.copy( (char *) decryptedData, (len - 11) > 16 ? 16 : (len - 11), 11 );
+		*decryptedLength = std::min( serviceData.length - offset, (size_t) 16 );
+		memcpy( decryptedData, v + offset, *decryptedLength );
 
 		return true;
 	}
 
-	if( key == nullptr )
+	if( ccmReady == false )
 	{
 		return false;
 	}
 
-	if( serviceData.length() < 22 && serviceData.length() > 23 )
+	if( serviceData.length < 22 || serviceData.length > 23 )
 	{
-		SERIAL_PRINTF("Payload size %u is not supported for decryption\n", serviceData.length() );
+		SERIAL_PRINTF("Payload size %u is not supported for decryption\n", serviceData.length );
 		return false;
 	}
 
@@ -68,7 +77,7 @@ bool LYWSD03MMCData::decryptServiceData( std::string &serviceData, const uint8_t
 	size_t  datasize = 4;
 	uint8_t iv[16];
 
-	if( serviceData.length() == 23 )
+	if( serviceData.length == 23 )
 	{
 		datasize = 5;  // temperature or humidity
 		offset = 1;
@@ -78,23 +87,13 @@ bool LYWSD03MMCData::decryptServiceData( std::string &serviceData, const uint8_t
 	memcpy( iv + 6, v + 2, 3);            // sensor type (2) + packet id (1)
 	memcpy( iv + 9, v + 15 + offset, 3);  // payload counter
 
-	mbedtls_ccm_context ctx;
-	mbedtls_ccm_init(&ctx);
-
-	if( mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, 16 * 8 ) != 0 )
-	{
-		mbedtls_ccm_free(&ctx);
-		return false;
-	}
-
-	if( mbedtls_ccm_auth_decrypt( &ctx, datasize, iv, 12, &authData, 1,
+	if( mbedtls_ccm_auth_decrypt( &ccm, datasize, iv, 12, &authData, 1,
 								 v + 11, decryptedData, v + 18 + offset, 4 ) != 0 )
 	{
-		mbedtls_ccm_free(&ctx);
 		return false;
 	}
 
-	mbedtls_ccm_free(&ctx);
+	*decryptedLength = datasize;
 	return true;
 }
 
@@ -105,201 +104,94 @@ bool LYWSD03MMCData::decryptServiceData( std::string &serviceData, const uint8_t
  * @param[in] serviceDataUUID UUID of advertised service data
  * @param[in] serviceData Service data from ADV packet
  */
-void LYWSD03MMCData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std::string &serviceData )
+void LYWSD03MMCData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
 {
-	if( this->address->equals( *address ) == false )
-	{
-		return;
-	}
-
 	SERIAL_PRINTF("Found device: %s alias: %s\n", address->toString().c_str(), alias );
 
-	bool tempNew = false;
-	bool humidityNew = false;
-	bool batNew = false;
+	uint8_t updated = 0;
 
 	advTimestamp = time( NULL );
 
-	// there are currently 2 custom firmwares for LYWSD03MMC:
-	// - from atc1441 - original one
-	// - from pvvx - fork of atc1441 with many enhancemets
-	// they both use 0x181A UUID for advertising, but format of data is not the same
+	stats.advCount++;
+	stats.addRssi( serviceData.rssi );
 
-	if( serviceDataUUID == 0x181A && serviceData.size() == 13 )
+	if( dupCache.isDuplicate( serviceDataUUID, serviceData.data, serviceData.length ) )
 	{
-		SERIAL_PRINTF("Detected data from atc1441 custom firmware\n" );
-
-		// unencrypted data from atc1441 custom firmware
-		uint8_t tempData[6];
-		serviceData.copy( (char*) tempData, 6, 6 );
-
-		values.temp = ((tempData[0] << 8) | tempData[1]) / 10.0;
-		values.tempTimestamp = advTimestamp;
-
-		values.humidity = (float) tempData[2];
-		values.humidityTimestamp = advTimestamp;
-
-		values.bat = (float) tempData[3];
-
-		values.voltage = ((tempData[4] << 8) | tempData[5]) / 1000.0;
-		values.batTimestamp = advTimestamp;
-
-		if( advTimestamp > nextTempNotify )
-		{
-			tempNew = true;
-			nextTempNotify = advTimestamp + cbkWaitTime;
-		}
-		if( advTimestamp > nextHumidityNotify )
-		{
-			humidityNew = true;
-			nextHumidityNotify = advTimestamp + cbkWaitTime;
-		}
-
-		if( advTimestamp > nextBatNotify )
-		{
-			batNew = true;
-			nextBatNotify = advTimestamp + cbkWaitTime;
-		}
+		stats.advDuplicates++;
+		return;
 	}
-	else if( serviceDataUUID == 0x181A && serviceData.size() >= 15 )
-	{
-		SERIAL_PRINTF("Detected data from pvvx custom firmware\n" );
-
-		// unencrypted data from pvvx custom firmware
-		uint8_t tempData[7];
-		serviceData.copy( (char*) tempData, 7, 6 );
-
-		values.temp = ((tempData[1] << 8) | tempData[0]) / 100.0;
-		values.tempTimestamp = advTimestamp;
-
-		values.humidity = (float) ((tempData[3] << 8) | tempData[2]) / 100.0;
-		values.humidityTimestamp = advTimestamp;
-
-		values.voltage = ((tempData[5] << 8) | tempData[4]) / 1000.0;
-		values.batTimestamp = advTimestamp;
 
-		values.bat = (float) tempData[6];
-
-		if( advTimestamp > nextTempNotify )
-		{
-			tempNew = true;
-			nextTempNotify = advTimestamp + cbkWaitTime;
-		}
-		if( advTimestamp > nextHumidityNotify )
-		{
-			humidityNew = true;
-			nextHumidityNotify = advTimestamp + cbkWaitTime;
-		}
+	// there are currently 2 custom firmwares for LYWSD03MMC:
+	// - from atc1441 - original one
+	// - from pvvx - fork of atc1441 with many enhancemets
+	// they both use 0x181A UUID for advertising, but format of data is not the same
 
-		if( advTimestamp > nextBatNotify )
-		{
-			batNew = true;
-			nextBatNotify = advTimestamp + cbkWaitTime;
-		}
-	}
-	else if( serviceDataUUID == 0xFE95 )
+	switch( advFormat( serviceDataUUID, serviceData.length ) )
 	{
-		SERIAL_PRINTF("Detected data from regular firmware\n" );
-
-		uint8_t serviceDataPerfix[4];
-		serviceData.copy( (char*) serviceDataPerfix, 4, 0 );
-
-		/* check for data prefix (0x58 == encrypted, 0x50 == not encrypted) */
-		if( (serviceDataPerfix[0] != 0x50 || serviceDataPerfix[1] != 0x30) &&
-				(serviceDataPerfix[0] != 0x58 || serviceDataPerfix[1] != 0x58) )
+		case ADV_FMT_ATC1441 :
 		{
-			SERIAL_PRINTF("Frame control data 0x%02X 0x%02X doesn't match expected values\n", serviceDataPerfix[0], serviceDataPerfix[1] );
-			return;
+			SERIAL_PRINTF("Detected data from atc1441 custom firmware\n" );
+			updated = AdvParser<ADV_FMT_ATC1441>::parse( serviceData.data, this, advTimestamp );
 		}
+		break;
 
-		if( serviceDataPerfix[2] != 0x5B || serviceDataPerfix[3] != 0x05 )
+		case ADV_FMT_PVVX :
 		{
-			SERIAL_PRINTF("Device type 0x%02X 0x%02Xxdoesn't match expectet value for LYWSD03MMC sensor\n", serviceDataPerfix[2], serviceDataPerfix[3] );
-	//		return; // Frame control is ok, so maybe other type of sensor with the same data format
+			SERIAL_PRINTF("Detected data from pvvx custom firmware\n" );
+			updated = AdvParser<ADV_FMT_PVVX>::parse( serviceData.data, this, advTimestamp );
 		}
+		break;
 
-		uint8_t tempData[16];
-
-		if( decryptServiceData( serviceData, this->key, tempData ) == false )
+		case ADV_FMT_MIBEACON :
 		{
-			SERIAL_PRINTF("Failed to decrypt service data from device %s\n", address->toString().c_str() );
-			return;
-		}
+			SERIAL_PRINTF("Detected data from regular firmware\n" );
 
-
-		switch( tempData[0] )
-		{
-			case 0x04:
+			// frame control (2), product ID (2), frame counter (1)
+			if( serviceData.length < 5 )
 			{
-				if( advTimestamp > nextTempNotify )
-				{
-					tempNew = true;
-					nextTempNotify = advTimestamp + cbkWaitTime;
-				}
-
-				values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
-				values.tempTimestamp = advTimestamp;
+				SERIAL_PRINTF("We don't have enough service data\n");
+				return;
 			}
-			break;
-
-			case 0x06:
-			{
-				if( advTimestamp > nextHumidityNotify )
-				{
-					humidityNew = true;
-					nextHumidityNotify = advTimestamp + cbkWaitTime;
-				}
 
-				values.humidity = ((tempData[4] << 8) | tempData[3]) / 10.0;
-				values.humidityTimestamp = advTimestamp;
-			}
-			break;
+			const uint8_t *serviceDataPerfix = serviceData.data;
 
-			case 0x0A:
+			/* check for data prefix (0x58 == encrypted, 0x50 == not encrypted) */
+			if( (serviceDataPerfix[0] != 0x50 || serviceDataPerfix[1] != 0x30) &&
+					(serviceDataPerfix[0] != 0x58 || serviceDataPerfix[1] != 0x58) )
 			{
-				if( advTimestamp > nextBatNotify )
-				{
-					batNew = true;
-					nextBatNotify = advTimestamp + cbkWaitTime;
-				}
-
-				values.bat = (float) tempData[3];
-
-				// emulate voltage -> 3.1V = 100%, 2.1V = 0%
-				values.voltage = 2.1 + (values.bat / 100.0);
-				values.batTimestamp = advTimestamp;
+				SERIAL_PRINTF("Frame control data 0x%02X 0x%02X doesn't match expected values\n", serviceDataPerfix[0], serviceDataPerfix[1] );
+				return;
 			}
-			break;
 
-			case 0x0D:
+			if( serviceDataPerfix[2] != 0x5B || serviceDataPerfix[3] != 0x05 )
 			{
-				if( advTimestamp > nextTempNotify )
-				{
-					tempNew = true;
-					nextTempNotify = advTimestamp + cbkWaitTime;
-				}
-
-				if( advTimestamp > nextHumidityNotify )
-				{
-					humidityNew = true;
-					nextHumidityNotify = advTimestamp + cbkWaitTime;
-				}
+				SERIAL_PRINTF("Device type 0x%02X 0x%02Xxdoesn't match expectet value for LYWSD03MMC sensor\n", serviceDataPerfix[2], serviceDataPerfix[3] );
+			//	return; // Frame control is ok, so maybe other type of sensor with the same data format
+			}
 
-				values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
-				values.humidity = ((tempData[6] << 8) | tempData[5]) / 10.0;
+			uint8_t tempData[16];
+			size_t  tempDataLength;
 
-				values.humidityTimestamp = advTimestamp;
-				values.tempTimestamp = advTimestamp;
+			if( decryptServiceData( serviceData, tempData, &tempDataLength ) == false )
+			{
+				SERIAL_PRINTF("Failed to decrypt service data from device %s\n", address->toString().c_str() );
+				return;
 			}
-			break;
 
+			updated = MiBeacon::decodeObjects( tempData, tempDataLength, this, advTimestamp );
+		}
+		break;
+
+		default :
+		{
+			SERIAL_PRINTF("Received service data with not interested UUID %u\n", serviceDataUUID );
+			return;
 		}
 	}
-	else
-	{
-		SERIAL_PRINTF("Received service data with not interested UUID %u\n", serviceDataUUID );
-		return;
-	}
+
+	bool tempNew = updated & SENSOR_NEW_TEMP;
+	bool humidityNew = updated & SENSOR_NEW_HUMIDITY;
+	bool batNew = updated & SENSOR_NEW_BAT;
 
 	if( tempNew || humidityNew || batNew )
 	{
@@ -312,18 +204,21 @@ void LYWSD03MMCData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, s
 
 /* ************************************************************************** */
 /**
- * @brief Initialise class. Call it if you don't have initialised bluetooth client. Method will initialise one client for you.
+ * @brief Initialise class. Call it if you don't have initialised bluetooth client. Method will initialise clients for you.
  * This method must be called once before any other calls (in setup() funcion)
  *
  * @param[in] refreshTime Time in seconds in which data will be automaticaly refreshed (0 = no automatic refresh)
  * @param[in] cbkWaitTime Minimum time in seconds between two callback calls for the same sensor value update
+ * @param[in] poolSize Number of concurrent connections (1 - LYWSD03MMC_MAX_CONNS)
  */
-void LYWSD03MMC::init( time_t refreshTime, time_t cbkWaitTime )
+void LYWSD03MMC::init( time_t refreshTime, time_t cbkWaitTime, uint8_t poolSize )
 {
-	BLEClient *pClient = BLEDevice::createClient();
-	pClient->setClientCallbacks( new DummyClientCallback() );
+	for( uint8_t i = 1; i < poolSize && i < LYWSD03MMC_MAX_CONNS; i++ )
+	{
+		addConn( bleTransport->createGattClient() );
+	}
 
-	init( pClient, refreshTime, cbkWaitTime );
+	init( bleTransport->createGattClient(), refreshTime, cbkWaitTime );
 }
 
 /* ************************************************************************** */
@@ -331,317 +226,1497 @@ void LYWSD03MMC::init( time_t refreshTime, time_t cbkWaitTime )
  * @brief Initialise class. Call it if you have already initialised bluetooth client.
  * This method must be called once before any other calls (in setup() function).
  *
- * @param[in] client Bluetooth client class
+ * @param[in] client GATT client of BLE transport
  * @param[in] refreshTime Time in seconds in which data will be automaticaly refreshed (0 = no automatic refresh)
  * @param[in] cbkWaitTime Minimum time in seconds between two callback calls for the same sensor value update
  */
-void LYWSD03MMC::init( BLEClient *client, time_t refreshTime, time_t cbkWaitTime )
+void LYWSD03MMC::init( BleGattClient *client, time_t refreshTime, time_t cbkWaitTime )
 {
-	bleClient = client;
+	addConn( client );
+
 	this->refreshTime = refreshTime;
 	this->cbkWaitTime = cbkWaitTime;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Sets data to sensor in @actDevice
+ * @brief Adds connection with given client to pool and starts its worker task
+ * @param[in] client GATT client of BLE transport
+ */
+void LYWSD03MMC::addConn( BleGattClient *client )
+{
+	if( connCount >= LYWSD03MMC_MAX_CONNS )
+	{
+		return;
+	}
+
+	ConnContext *conn = &conns[connCount++];
+
+	conn->owner = this;
+	conn->client = client;
+
+	// notifications and read results are routed by client directly to its connection
+	client->setCbk( conn );
+
+	// GATT client calls are blocking - they are done in own task, so loop() is never blocked by radio
+	xTaskCreate( connTaskMain, "LYWSD03MMC", 4096, conn, 1, &conn->task );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets data to sensor
+ * @param[in] device Device with received data
  * @param[in] temp Actual temperature
  * @param[in] humidity Actual humidity
  * @param[in] voltage Actual voltage
  */
-void LYWSD03MMC::setData( float temp, float humidity, float voltage )
+void LYWSD03MMC::setData( LYWSD03MMCData *device, float temp, float humidity, float voltage )
 {
-	if( actDevice )
+	if( device )
 	{
 		SERIAL_PRINTF("Received data for %s: temp = %.1f : humidity = %.0f : voltage = %f\n",
-				actDevice->alias, temp, humidity, voltage );
+				device->alias, temp, humidity, voltage );
 
-		actDevice->values.tempTimestamp = actDevice->values.humidityTimestamp = actDevice->values.batTimestamp= time( NULL );
-		actDevice->values.temp = temp;
-		actDevice->values.humidity = humidity;
-		actDevice->values.voltage = voltage;
+		device->values.tempTimestamp = device->values.humidityTimestamp = device->values.batTimestamp= time( NULL );
+		device->values.temp = temp;
+		device->values.humidity = humidity;
+		device->values.voltage = voltage;
 
 		// emulate battery percentage -> 3.1V = 100%, 2.1V = 0%
 		if( voltage > 3.1 )
 		{
 			voltage = 3.1;
 		}
-		actDevice->values.bat = 100.0 - ((3.1 - voltage) * 100.0);
+		device->values.bat = 100.0 - ((3.1 - voltage) * 100.0);
 
-		if( actDevice->values.bat < 0.0 )
+		if( device->values.bat < 0.0 )
 		{
-			actDevice->values.bat = 0.0;
+			device->values.bat = 0.0;
 		}
 
 		for( auto it = regCbks.cbegin(); it != regCbks.cend(); it++ )
     	{
-   			(*it)->onData( actDevice->address, actDevice->alias, true, true, true );
+   			(*it)->onData( device->address, device->alias, true, true, true );
     	}
 	}
 }
 
 /* ************************************************************************** */
 /**
- * @brief Callback called when notification from sensor is received
- * @param[in] pBLERemoteCharacteristic Registered characteristics
- * @param[in] data Data received in notification
- * @param[in] dataLength Length of received data
- * @param[in] isNotify True when notification was received
+ * @brief Parses value of data characteristic
+ * @param[in] data Value of characteristic
+ * @param[in] dataLength Length of value
+ * @param[out] temp Temperature
+ * @param[out] humidity Humidity
+ * @param[out] voltage Battery voltage
+ * @return Returns false if value is too short
  */
-void LYWSD03MMC::notifyCallback( BLERemoteCharacteristic* pBLERemoteCharacteristic,
-		uint8_t *data, size_t dataLength, bool isNotify )
+bool LYWSD03MMC::parseData( const uint8_t *data, size_t dataLength, float *temp, float *humidity, float *voltage )
 {
-	float   temp;
-	float   voltage;
-	float   humidity;
+	if( dataLength < 5 )
+	{
+		SERIAL_PRINTF("Notification with unexpected length %u\n", dataLength );
+		return false;
+	}
 
-	temp = (data[0] | (data[1] << 8)) * 0.01; //little endian
-	humidity = (float) data[2];
-	voltage = (data[3] | (data[4] << 8)) * 0.001; //little endian
+	*temp = (int16_t)(data[0] | (data[1] << 8)) * 0.01; //little endian
+	*humidity = (float) data[2];
+	*voltage = (data[3] | (data[4] << 8)) * 0.001; //little endian
 
-	lywsd03mmc.setData( temp, humidity, voltage );
-	lywsd03mmc.state = ST_HAVE_DATA_CONNECTED;
+	return true;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Returns remote characteristics
- * @param[in] xcharUUID characteristics UUID
- * @return Returns remote characteristics or nullptr if error occured
+ * @brief Parses one record of history records characteristic
+ * @param[in] data Value of characteristic
+ * @param[in] dataLength Length of value
+ * @param[out] record Parsed record
+ * @return Returns false if value is too short
  */
-BLERemoteCharacteristic *LYWSD03MMC::getMainCharacteristic( BLEUUID &xcharUUID )
+bool LYWSD03MMC::parseHistoryRecord( const uint8_t *data, size_t dataLength, LYWSD03MMCHistory *record )
 {
-	BLERemoteService        *remService;
-	BLERemoteCharacteristic *remCharacteristic;
-
-	if( bleClient->isConnected() == false )
-	{
-		return nullptr;
-	}
-
-	// Obtain a reference to the service we are after in the remote BLE server.
-	if( (remService = bleClient->getService(serviceUUID) ) == nullptr )
+	if( dataLength < 14 )
 	{
-		SERIAL_PRINTLN("Failed to get service");
-		return nullptr;
+		SERIAL_PRINTF("History record with unexpected length %u\n", dataLength );
+		return false;
 	}
 
-	// Obtain a reference to the characteristic in the service of the remote BLE server.
-	if( (remCharacteristic = remService->getCharacteristic(xcharUUID)) == nullptr )
-	{
-		SERIAL_PRINTLN("Failed to get characteristic");
-		return nullptr;
-	}
+	record->index = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24); //little endian
+	record->timestamp = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t) data[7] << 24);
+	record->tempMax = (int16_t)(data[8] | (data[9] << 8)) * 0.1;
+	record->humidityMax = (float) data[10];
+	record->tempMin = (int16_t)(data[11] | (data[12] << 8)) * 0.1;
+	record->humidityMin = (float) data[13];
 
-	return remCharacteristic;
+	return true;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Returns remote characteristics
- * @param[in] xcharUUID characteristics UUID
- * @return Returns remote characteristics or nullptr if error occured
+ * @brief Parses one record of log sent by pvvx firmware as response to log command
+ * @param[in] data Value of command characteristic
+ * @param[in] dataLength Length of value
+ * @param[out] record Parsed record - measured values are both min and max, timestamp is by sensor clock
+ * @return Returns false if value is not log record (e.g. end of log)
  */
-int LYWSD03MMC::registerNotification( bool doRegister )
+bool LYWSD03MMC::parsePvvxLogRecord( const uint8_t *data, size_t dataLength, LYWSD03MMCHistory *record )
 {
-	BLERemoteCharacteristic *remCharacteristic;
-
-	if( (remCharacteristic = getMainCharacteristic( charUUID )) == nullptr )
+	// id, number (u16), time (u32), temperature (s16, 0.01), humidity (u16, 0.01), battery voltage (u16, mV)
+	if( dataLength < 13 || data[0] != PVVX_CMD_LOG )
 	{
-		SERIAL_PRINTLN("Failed to find remote characteristic UUID");
-		return -1;
+		return false;
 	}
 
-	remCharacteristic->registerForNotify( doRegister ? notifyCallback : nullptr );
+	record->index = data[1] | (data[2] << 8); //little endian
+	record->timestamp = data[3] | (data[4] << 8) | (data[5] << 16) | ((uint32_t) data[6] << 24);
+	record->tempMax = record->tempMin = (int16_t)(data[7] | (data[8] << 8)) * 0.01;
+	record->humidityMax = record->humidityMin = (data[9] | (data[10] << 8)) * 0.01;
 
-	return 0;
+	return true;
 }
 
 /* ************************************************************************** */
 /**
- * @brief Sets BLE communication interval to 500ms (for battery save)
+ * @brief Callback called when data from sensor are received (by notification or direct read)
+ * @param[in] conn Connection with received data
+ * @param[in] data Received data
+ * @param[in] dataLength Length of received data
  */
-void LYWSD03MMC::setCommunicationInterval()
+void LYWSD03MMC::notifyCallback( ConnContext *conn, const uint8_t *data, size_t dataLength )
 {
-	// Comunicacion interval = 0x01F4 = 500ms
-	uint8_t setCommInterval[] = { 0xf4, 0x01 };
-	BLERemoteCharacteristic *remCharacteristic;
+	float   temp;
+	float   voltage;
+	float   humidity;
+
+	ConnState state = conn->state;
 
-	if( (remCharacteristic = getMainCharacteristic( charUUID_SetIntervalComm )) == nullptr )
+	// notification can come right after enabling, before worker task moves to waiting state
+	if( (state != CONN_READING && state != CONN_SUBSCRIBING && state != CONN_WAITING) || conn->haveData )
 	{
-		SERIAL_PRINTLN("Failed to find remote characteristic UUID_SetIntervalComm");
 		return;
 	}
 
-	// Write the value of the characteristic.
-	remCharacteristic->writeValue( setCommInterval, 2, true );
+	if( parseData( data, dataLength, &temp, &humidity, &voltage ) == false )
+	{
+		return;
+	}
+
+	// data are only stored here (BT task) - they are set and callbacks are called from process()
+	conn->temp = temp;
+	conn->humidity = humidity;
+	conn->voltage = voltage;
+	conn->dataMillis = millis();
+	conn->dataByRead = (state == CONN_READING);
+	conn->haveData = true;
+
+	xTaskNotifyGive( conn->task );
 }
 
 /* ************************************************************************** */
 /**
- * @brief Enables receiving of notifications from sensor
- * @param[in] doEnable true for enable, false for disable
- * @return Returns 0 on success or <0 if error occured
+ * @brief Callback called when history record from sensor is received (called from BT task)
+ * @param[in] conn Connection with received record
+ * @param[in] data Received record
+ * @param[in] dataLength Length of received record
  */
-int LYWSD03MMC::enableNotifications( bool doEnable )
+void LYWSD03MMC::historyCallback( ConnContext *conn, const uint8_t *data, size_t dataLength )
 {
-	BLERemoteCharacteristic *remCharacteristic;
-	BLERemoteDescriptor     *remDescriptor;
-
-	uint8_t notificationOn[]  = {0x1, 0x0};
-	uint8_t notificationOff[] = {0x0, 0x0};
+	LYWSD03MMCHistory record;
 
-	if( (remCharacteristic = getMainCharacteristic( charUUID )) == nullptr )
+	if( conn->state != CONN_HISTORY || conn->histDone )
 	{
-		SERIAL_PRINTLN("Failed to find remote characteristic UUID");
-		return -1;
+		return;
 	}
 
-	if( (remDescriptor = remCharacteristic->getDescriptor( BLEUUID((uint16_t) 0x2902) )) == nullptr )
+	if( parseHistoryRecord( data, dataLength, &record ) == false )
 	{
-		return -2;
+		return;
 	}
 
-	remDescriptor->writeValue( doEnable ? notificationOn : notificationOff, 2, true );
+	// records are only stored here (BT task) to space reserved by worker - they are merged to device from process()
+	if( conn->histRecords.size() < conn->owner->backfillMax )
+	{
+		conn->histRecords.push_back( record );
+	}
 
-	return 0;
+	if( record.index + 1 >= conn->histNext || conn->histRecords.size() >= conn->owner->backfillMax )
+	{
+		conn->histDone = true;
+		xTaskNotifyGive( conn->task );
+	}
 }
 
 /* ************************************************************************** */
 /**
- * @brief Connects to sensor with parameteris in @actDevice
+ * @brief Callback called when response to command of pvvx firmware is received (called from BT task)
+ * @param[in] conn Connection with received response
+ * @param[in] data Received response
+ * @param[in] dataLength Length of received response
  */
-void LYWSD03MMC::connectSensor()
+void LYWSD03MMC::pvvxCallback( ConnContext *conn, const uint8_t *data, size_t dataLength )
 {
-	if( bleClient->connect( *actDevice->address ) == true )
+	LYWSD03MMCHistory record;
+
+	if( conn->state != CONN_HISTORY || conn->histDone || dataLength == 0 )
+	{
+		return;
+	}
+
+	// time is requested first - log is requested only after it is received
+	if( conn->sensorTime == 0 )
+	{
+		if( data[0] == PVVX_CMD_TIME && dataLength >= 5 )
+		{
+			conn->sensorTime = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t) data[4] << 24);
+			conn->histDone = true;
+			xTaskNotifyGive( conn->task );
+		}
+
+		return;
+	}
+
+	if( parsePvvxLogRecord( data, dataLength, &record ) )
+	{
+		// records are sent from the newest one - the rest was fetched by previous connections
+		if( record.timestamp > conn->histAfter )
+		{
+			conn->histRecords.push_back( record );
+
+			if( conn->histRecords.size() < conn->owner->backfillMax )
+			{
+				return;
+			}
+		}
+	}
+	else if( data[0] != PVVX_CMD_LOG || dataLength < 3 || data[1] != 0 || data[2] != 0 )
 	{
-//		setCommunicationInterval();
-		registerNotification();
-		enableNotifications();
+		// response to other command
+		return;
 	}
+
+	conn->histDone = true;
+	xTaskNotifyGive( conn->task );
 }
 
 /* ************************************************************************** */
 /**
- * @brief Disconnects form already connected sensor
+ * @brief Method called by GATT client when notification is received (called from BT task)
+ * @param[in] handle Handle of characteristic
+ * @param[in] data Value of characteristic
+ * @param[in] length Length of value
  */
-void LYWSD03MMC::disconnectSensor()
+void LYWSD03MMC::ConnContext::onNotify( uint16_t handle, const uint8_t *data, size_t length )
 {
-	enableNotifications( false );
-	registerNotification( false );
-	bleClient->disconnect();
+	// device is loaded only once - process() clears it when finished connection is returned to pool
+	ConnState       connState = state;
+	LYWSD03MMCData *current = device;
+
+	// late events of finished connection are ignored
+	if( connState == CONN_IDLE || connState == CONN_DONE || current == nullptr )
+	{
+		return;
+	}
+
+	// data are matched by cached handle - remote characteristic objects are not needed
+	if( current->charHandle != 0 && handle == current->charHandle )
+	{
+		notifyCallback( this, data, length );
+	}
+	else if( current->histDataHandle != 0 && handle == current->histDataHandle )
+	{
+		historyCallback( this, data, length );
+	}
+	else if( current->pvvxCmdHandle != 0 && handle == current->pvvxCmdHandle )
+	{
+		pvvxCallback( this, data, length );
+	}
 }
 
 /* ************************************************************************** */
 /**
- * @brief Method to handle everything needed - should be called in every loop() iteration
+ * @brief Method called by GATT client when read requested by read() is finished (called from BT task)
+ * @param[in] handle Handle of characteristic
+ * @param[in] ok true if read succeeded, false if it was answered with error
+ * @param[in] data Value of characteristic
+ * @param[in] length Length of value
  */
-void LYWSD03MMC::process()
+void LYWSD03MMC::ConnContext::onRead( uint16_t handle, bool ok, const uint8_t *data, size_t length )
 {
-	if( bleAdvListener.isScanRunning() == true )
+	// device is loaded only once - process() clears it when finished connection is returned to pool
+	ConnState       connState = state;
+	LYWSD03MMCData *current = device;
+
+	// late events of finished connection are ignored
+	if( connState == CONN_IDLE || connState == CONN_DONE || current == nullptr )
 	{
 		return;
 	}
 
-	time_t actTime = time( NULL );
-
-	switch( state )
+	if( current->charHandle != 0 && handle == current->charHandle && connState == CONN_READING )
 	{
-		case ST_NOT_CONNECTED :
-		{
-		}
-		break;
-
-		case ST_WAITING_FOR_DATA :
+		if( ok )
 		{
-			if( (actTime - connStart) > connTimeout )
-			{
-				disconnectSensor();
-				state = ST_NOT_CONNECTED;
-				bleAdvListener.setPaused( false );
-
-				SERIAL_PRINTF("Disconnected from sensor %s due timeout\n", actDevice->alias );
-				return;
-			}
+			notifyCallback( this, data, length );
 		}
-		break;
-
-		case ST_HAVE_DATA_CONNECTED :
+		else
 		{
-			disconnectSensor();
-			state = ST_NOT_CONNECTED;
-			bleAdvListener.setPaused( false );
-
-			SERIAL_PRINTF("Disconnected from sensor %s after data received\n", actDevice->alias );
-			return;
+			readFailed = true;
+			xTaskNotifyGive( task );
 		}
-		break;
 	}
-
-	if( state == ST_NOT_CONNECTED )
+	else if( current->timeHandle != 0 && handle == current->timeHandle && connState == CONN_HISTORY )
 	{
-		LYWSD03MMCData *actDevice = nullptr;
-
-		/* find device that needs data refresh */
-		for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+		if( ok && length >= 4 )
 		{
-			if( (*it)->nextRefresh && (*it)->nextRefresh < actTime )
-			{
-				/* check the time of last ADV packet to see, if the device is "near" */
-				if( (*it)->advTimestamp >= 0 && (actTime - (*it)->advTimestamp) < maxAdvTimeout )
-				{
-					actDevice = *it;
-					break;
-				}
-			}
+			sensorTime = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24); //little endian
 		}
 
-		if( actDevice != nullptr )
+		histDone = true;
+		xTaskNotifyGive( task );
+	}
+	else if( current->histRangeHandle != 0 && handle == current->histRangeHandle && connState == CONN_HISTORY )
+	{
+		// first and next record index - both little endian
+		if( ok && length >= 8 )
 		{
-			SERIAL_PRINTF("Connecting and requesting data from sensor %s ...\n", actDevice->alias );
-
-			this->actDevice = actDevice;
-			connStart = actTime;
-
-			if( refreshTime )
-			{
-				actDevice->nextRefresh = actTime + refreshTime;
-			}
-			else
-			{
-				actDevice->nextRefresh = 0;
-			}
-
-			bleAdvListener.setPaused( true );
-			connectSensor();
-			state = ST_WAITING_FOR_DATA;
+			histFirst = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+			histNext = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t) data[7] << 24);
 		}
+
+		histDone = true;
+		xTaskNotifyGive( task );
 	}
 }
 
 /* ************************************************************************** */
 /**
- * @brief Registers new LYWSD03MMC devices MAC address that we want to get data from
- * @param[in] address MAC address of device
- * @param[in] alias Our device alias
- * @param[in] key Key for decrypting ADV packets in passive mode
+ * @brief Runs service discovery and stores handles of characteristics to device of connection
+ * @param[in] conn Connection to use
+ * @return Returns 0 on success or <0 if error occured
  */
-void LYWSD03MMC::deviceRegister( BLEAddress *address, const char *alias, const uint8_t *key )
+int LYWSD03MMC::discoverHandles( ConnContext *conn )
 {
-	LYWSD03MMCData *data = new LYWSD03MMCData( address, alias, key );
+	LYWSD03MMCData *device = conn->device;
+	uint16_t        handle;
+	uint16_t        cccdHandle;
 
-	if( refreshTime )
+	// first search runs service discovery
+	if( conn->client->findCharacteristic( serviceUUID, charUUID, &handle, &cccdHandle ) == false )
 	{
-		data->nextRefresh = 1 + std::distance( regDevices.cbegin(), regDevices.cend() ) * (connTimeout * 2);
+		SERIAL_PRINTLN("Failed to find remote characteristic UUID");
+		return -1;
 	}
 
-	data->cbkWaitTime = cbkWaitTime;
-	data->regCbks = &regCbks;
-	bleAdvListener.cbkRegister( data );
+	if( cccdHandle == 0 )
+	{
+		return -2;
+	}
+
+	device->cccdHandle = cccdHandle;
+	device->charHandle = handle;
+
+	// characteristics of service are already retrieved - this doesn't start another discovery
+	if( conn->client->findCharacteristic( serviceUUID, charUUID_SetIntervalComm, &handle ) )
+	{
+		device->commHandle = handle;
+	}
+
+	// history is optional - custom firmwares don't have these characteristics
+	if( conn->client->findCharacteristic( serviceUUID, charUUID_HistData, &handle, &cccdHandle ) && cccdHandle != 0 )
+	{
+		device->histDataHandle = handle;
+		device->histCccdHandle = cccdHandle;
+
+		if( conn->client->findCharacteristic( serviceUUID, charUUID_HistRange, &handle ) )
+		{
+			device->histRangeHandle = handle;
+		}
+
+		if( conn->client->findCharacteristic( serviceUUID, charUUID_HistIndex, &handle ) )
+		{
+			device->histIndexHandle = handle;
+		}
+
+		if( conn->client->findCharacteristic( serviceUUID, charUUID_Time, &handle ) )
+		{
+			device->timeHandle = handle;
+		}
+	}
+	// pvvx firmware keeps its measurements in log read by commands of own service
+	else if( conn->client->findCharacteristic( pvvxServiceUUID, pvvxCharUUID_Cmd, &handle, &cccdHandle ) && cccdHandle != 0 )
+	{
+		device->pvvxCmdHandle = handle;
+		device->pvvxCccdHandle = cccdHandle;
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Registers notifications for cached characteristic handle in local stack
+ * @param[in] conn Connection to use
+ * @param[in] handle Handle of characteristic
+ * @param[in] doRegister true for register, false for unregister
+ * @return Returns 0 on success or <0 if error occured
+ */
+int LYWSD03MMC::registerNotification( ConnContext *conn, uint16_t handle, bool doRegister )
+{
+	return conn->client->registerNotify( handle, doRegister ) ? 0 : -1;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets BLE communication interval to 500ms (for battery save)
+ * @param[in] conn Connection to use
+ */
+void LYWSD03MMC::setCommunicationInterval( ConnContext *conn )
+{
+	// Comunicacion interval = 0x01F4 = 500ms
+	uint8_t setCommInterval[] = { 0xf4, 0x01 };
+	LYWSD03MMCData *device = conn->device;
+
+	if( device->commHandle == 0 )
+	{
+		SERIAL_PRINTLN("Failed to find remote characteristic UUID_SetIntervalComm");
+		return;
+	}
+
+	// Write the value of the characteristic.
+	conn->client->write( device->commHandle, setCommInterval, sizeof( setCommInterval ) );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Enables receiving of notifications from sensor
+ * @param[in] conn Connection to use
+ * @param[in] cccdHandle Handle of client characteristic configuration descriptor
+ * @param[in] doEnable true for enable, false for disable
+ * @return Returns 0 on success or <0 if error occured
+ */
+int LYWSD03MMC::enableNotifications( ConnContext *conn, uint16_t cccdHandle, bool doEnable )
+{
+	uint8_t notificationOn[]  = {0x1, 0x0};
+	uint8_t notificationOff[] = {0x0, 0x0};
+
+	if( conn->client->isConnected() == false )
+	{
+		return -1;
+	}
+
+	// CCCD is written directly by cached handle
+	if( conn->client->writeDescriptor( cccdHandle, doEnable ? notificationOn : notificationOff, 2 ) == false )
+	{
+		return -2;
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Main function of connection worker task - waits for requests from process() and handles them
+ * @param[in] param Pointer to connection context of task
+ */
+void LYWSD03MMC::connTaskMain( void *param )
+{
+	ConnContext *conn = (ConnContext *) param;
+
+	for( ;; )
+	{
+		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+		// wake up can be caused also by late notification from previous connection
+		if( conn->state == CONN_CONNECTING )
+		{
+			conn->owner->connectSensor( conn );
+			conn->state = CONN_DONE;
+		}
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Connects to sensor of connection, waits for data and disconnects (called from worker task)
+ * @param[in] conn Connection to use
+ */
+void LYWSD03MMC::connectSensor( ConnContext *conn )
+{
+	TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS( connTimeout * 1000 );
+	uint32_t   linkStart = millis();
+	LYWSD03MMCData *device = conn->device;
+
+	if( conn->client->connect( *device->address ) == true )
+	{
+		bool cached = (device->charHandle != 0);
+
+		updateConnParams( conn, fastParams );
+
+		conn->state = CONN_DISCOVERING;
+
+		// full service discovery is done only once - later connections use cached handles
+		if( cached || discoverHandles( conn ) == 0 )
+		{
+			if( directRead )
+			{
+				TickType_t readDeadline = xTaskGetTickCount() + pdMS_TO_TICKS( readTimeout );
+
+				conn->state = CONN_READING;
+				conn->readTried = true;
+
+				if( conn->client->read( device->charHandle ) )
+				{
+					waitForData( conn, ((int32_t)(readDeadline - deadline) < 0) ? readDeadline : deadline );
+				}
+			}
+
+			// sensor pushes its data by notification - used also when direct read fails
+			if( conn->haveData == false )
+			{
+				conn->state = CONN_SUBSCRIBING;
+
+//				setCommunicationInterval( conn );
+				if( registerNotification( conn, device->charHandle ) == 0 && enableNotifications( conn, device->cccdHandle ) == 0 )
+				{
+					conn->subscribed = true;
+					conn->state = CONN_WAITING;
+
+					// sensor sends notification in few seconds - link can be slower meanwhile
+					updateConnParams( conn, slowParams );
+
+					waitForData( conn, deadline );
+				}
+			}
+		}
+
+		// sensor stores one record per hour - there is something new to download only once per hour
+		if( backfillMax && conn->haveData &&
+				(device->histFetched == 0 || conn->start - device->histFetched >= LYWSD03MMC_HISTORY_PERIOD) )
+		{
+			backfillHistory( conn );
+		}
+
+		conn->state = CONN_TEARDOWN;
+		disconnectSensor( conn );
+
+		conn->linkMillis = millis() - linkStart;
+
+		if( cached && conn->haveData == false )
+		{
+			// handles could be changed (e.g. by firmware update) - discover them again next time
+			device->charHandle = device->cccdHandle = device->commHandle = 0;
+			device->histRangeHandle = device->histIndexHandle = device->histDataHandle = device->histCccdHandle = 0;
+			device->timeHandle = device->pvvxCmdHandle = device->pvvxCccdHandle = 0;
+		}
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Requests change of connection parameters by GAP connection parameter update
+ * @param[in] conn Connection to use
+ * @param[in] params Requested parameters
+ */
+void LYWSD03MMC::updateConnParams( ConnContext *conn, const LYWSD03MMCConnParams &params )
+{
+	if( params.minInterval == 0 )
+	{
+		return;
+	}
+
+	if( conn->client->updateConnParams( params.minInterval, params.maxInterval, params.latency, params.timeout ) == false )
+	{
+		SERIAL_PRINTF("Failed to request connection parameters for %s\n", conn->device.load()->alias );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Waits in worker task until data are received, direct read fails or deadline expires
+ * @param[in] conn Connection to wait for
+ * @param[in] deadline Tick count when waiting ends
+ */
+void LYWSD03MMC::waitForData( ConnContext *conn, TickType_t deadline )
+{
+	for( TickType_t now = xTaskGetTickCount(); conn->haveData == false && (int32_t)(deadline - now) > 0; now = xTaskGetTickCount() )
+	{
+		if( conn->state == CONN_READING && conn->readFailed )
+		{
+			break;
+		}
+
+		ulTaskNotifyTake( pdTRUE, deadline - now );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Downloads history records not fetched yet from sensor memory (called from worker task)
+ * @param[in] conn Connection to use
+ */
+void LYWSD03MMC::backfillHistory( ConnContext *conn )
+{
+	LYWSD03MMCData *device = conn->device;
+	TickType_t      deadline = xTaskGetTickCount() + pdMS_TO_TICKS( backfillTimeout * 1000 );
+	uint8_t         startIndex[4];
+
+	// records without sensor clock can't be converted to gateway clock
+	if( device->pvvxCmdHandle == 0 &&
+			(device->histRangeHandle == 0 || device->histIndexHandle == 0 || device->histDataHandle == 0 || device->timeHandle == 0) )
+	{
+		return;
+	}
+
+	conn->histTried = true;
+	conn->histFirst = conn->histNext = 0;
+	conn->sensorTime = 0;
+	conn->histDone = false;
+	conn->histRecords.reserve( backfillMax );
+	conn->state = CONN_HISTORY;
+
+	// link could be slowed down while waiting for notification - records are downloaded with fast parameters
+	updateConnParams( conn, fastParams );
+
+	if( device->pvvxCmdHandle )
+	{
+		backfillPvvxLog( conn, deadline );
+		return;
+	}
+
+	// timestamps of records are by sensor clock - it is read in the same connection as records
+	if( conn->client->read( device->timeHandle ) == false )
+	{
+		return;
+	}
+
+	waitForHistory( conn, deadline );
+
+	if( conn->sensorTime == 0 )
+	{
+		return;
+	}
+
+	conn->timeOffset = time( NULL ) - (time_t) conn->sensorTime;
+	conn->histDone = false;
+
+	if( conn->client->read( device->histRangeHandle ) == false )
+	{
+		return;
+	}
+
+	waitForHistory( conn, deadline );
+
+	// range was not received or sensor memory is empty
+	if( conn->histNext <= conn->histFirst )
+	{
+		return;
+	}
+
+	// continue after the last fetched record - index out of range means first backfill or cleared sensor memory
+	if( device->histNextIndex > conn->histFirst && device->histNextIndex <= conn->histNext )
+	{
+		conn->histStart = device->histNextIndex;
+	}
+	else
+	{
+		conn->histStart = conn->histFirst;
+	}
+
+	if( conn->histNext - conn->histStart > backfillMax )
+	{
+		conn->histStart = conn->histNext - backfillMax;
+	}
+
+	if( conn->histStart == conn->histNext )
+	{
+		return;
+	}
+
+	startIndex[0] = conn->histStart & 0xff;
+	startIndex[1] = (conn->histStart >> 8) & 0xff;
+	startIndex[2] = (conn->histStart >> 16) & 0xff;
+	startIndex[3] = (conn->histStart >> 24) & 0xff;
+
+	conn->histDone = false;
+
+	// sensor sends records from written index up to the newest one in one burst of notifications
+	if( conn->client->write( device->histIndexHandle, startIndex, sizeof( startIndex ) ) == false )
+	{
+		return;
+	}
+
+	if( registerNotification( conn, device->histDataHandle ) == 0 )
+	{
+		if( enableNotifications( conn, device->histCccdHandle ) == 0 )
+		{
+			waitForHistory( conn, deadline );
+
+			enableNotifications( conn, device->histCccdHandle, false );
+		}
+
+		registerNotification( conn, device->histDataHandle, false );
+	}
+
+	SERIAL_PRINTF("Received %u of %u history records from %s\n", conn->histRecords.size(),
+			conn->histNext - conn->histStart, device->alias );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Downloads log records not fetched yet from memory of sensor with pvvx firmware (called from worker task)
+ * @param[in] conn Connection to use
+ * @param[in] deadline Tick count when download ends
+ */
+void LYWSD03MMC::backfillPvvxLog( ConnContext *conn, TickType_t deadline )
+{
+	LYWSD03MMCData *device = conn->device;
+	uint8_t         timeCmd[1] = { PVVX_CMD_TIME };
+	uint8_t         logCmd[5] = { PVVX_CMD_LOG, (uint8_t) (backfillMax & 0xff), (uint8_t) (backfillMax >> 8), 0, 0 };
+
+	if( registerNotification( conn, device->pvvxCmdHandle ) != 0 )
+	{
+		return;
+	}
+
+	if( enableNotifications( conn, device->pvvxCccdHandle ) == 0 )
+	{
+		// timestamps of records are by sensor clock - it is requested in the same connection as records
+		if( conn->client->write( device->pvvxCmdHandle, timeCmd, sizeof( timeCmd ) ) )
+		{
+			waitForHistory( conn, deadline );
+		}
+
+		if( conn->sensorTime != 0 )
+		{
+			conn->timeOffset = time( NULL ) - (time_t) conn->sensorTime;
+
+			// sensor clock was reset (e.g. by battery replacement) - log is fetched again from the newest record
+			conn->histAfter = (device->histLastTime <= conn->sensorTime) ? device->histLastTime : 0;
+			conn->histDone = false;
+
+			// sensor sends records from the newest one until count, already fetched record or end of log
+			if( conn->client->write( device->pvvxCmdHandle, logCmd, sizeof( logCmd ) ) )
+			{
+				waitForHistory( conn, deadline );
+			}
+
+			SERIAL_PRINTF("Received %u log records from %s\n", conn->histRecords.size(), device->alias );
+		}
+
+		enableNotifications( conn, device->pvvxCccdHandle, false );
+	}
+
+	registerNotification( conn, device->pvvxCmdHandle, false );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Waits in worker task until history range or all requested records are received or deadline expires
+ * @param[in] conn Connection to wait for
+ * @param[in] deadline Tick count when waiting ends
+ */
+void LYWSD03MMC::waitForHistory( ConnContext *conn, TickType_t deadline )
+{
+	for( TickType_t now = xTaskGetTickCount(); conn->histDone == false && (int32_t)(deadline - now) > 0; now = xTaskGetTickCount() )
+	{
+		ulTaskNotifyTake( pdTRUE, deadline - now );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Disconnects form already connected sensor
+ * @param[in] conn Connection to use
+ */
+void LYWSD03MMC::disconnectSensor( ConnContext *conn )
+{
+	LYWSD03MMCData *device = conn->device;
+
+	if( conn->subscribed )
+	{
+		enableNotifications( conn, device->cccdHandle, false );
+		registerNotification( conn, device->charHandle, false );
+	}
+
+	conn->client->disconnect();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Compares devices by planned refresh - used for min-heap of devices
+ */
+bool LYWSD03MMC::refreshLater( const LYWSD03MMCData *a, const LYWSD03MMCData *b )
+{
+	return a->nextRefresh > b->nextRefresh;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Plans next data refresh of device
+ * @param[in] device Device to refresh
+ * @param[in] nextRefresh Time of refresh (0 = no refresh)
+ */
+void LYWSD03MMC::scheduleRefresh( LYWSD03MMCData *device, time_t nextRefresh )
+{
+	device->nextRefresh = nextRefresh;
+
+	if( device->queued )
+	{
+		if( nextRefresh == 0 )
+		{
+			refreshQueue.erase( std::find( refreshQueue.begin(), refreshQueue.end(), device ) );
+			device->queued = false;
+		}
+
+		// key of device inside of heap was changed (forced refresh, retry after failure, adaptive refresh) -
+		// heap is rebuilt, which is O(n), but it happens at most once per connection or forced refresh and n is number of sensors
+		std::make_heap( refreshQueue.begin(), refreshQueue.end(), refreshLater );
+	}
+	else if( nextRefresh )
+	{
+		refreshQueue.push_back( device );
+		std::push_heap( refreshQueue.begin(), refreshQueue.end(), refreshLater );
+		device->queued = true;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Computes time until which are all values of device fresh enough to skip connection
+ * @param[in] device Device to check
+ * @return Returns time when the oldest value exceeds its budget (0 = hybrid mode is disabled)
+ */
+time_t LYWSD03MMC::freshUntil( const LYWSD03MMCData *device )
+{
+	if( tempBudget == 0 || humidityBudget == 0 || batBudget == 0 )
+	{
+		return 0;
+	}
+
+	time_t until = device->values.tempTimestamp + tempBudget;
+
+	if( device->values.humidityTimestamp + humidityBudget < until )
+	{
+		until = device->values.humidityTimestamp + humidityBudget;
+	}
+
+	if( device->values.batTimestamp + batBudget < until )
+	{
+		until = device->values.batTimestamp + batBudget;
+	}
+
+	return until;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Takes device with the strongest signal from devices which are due, near (ADV packet received recently,
+ * RSSI above floor) and whose passive data are not fresh. Devices with fresh data are planned again on time
+ * when data becomes stale.
+ * @param[in] actTime Actual time
+ * @param[in] take false only checks that there is such device - it stays in queue
+ * @return Returns device to refresh or nullptr if there is no such device
+ */
+LYWSD03MMCData *LYWSD03MMC::takeDueDevice( time_t actTime, bool take )
+{
+	LYWSD03MMCData *found = nullptr;
+	size_t          skipped = 0;
+
+	// all due devices are moved behind heap, the best one is taken and others are returned back after search
+	while( refreshQueue.size() > skipped && refreshQueue.front()->nextRefresh < actTime )
+	{
+		std::pop_heap( refreshQueue.begin(), refreshQueue.end() - skipped, refreshLater );
+
+		LYWSD03MMCData *device = *(refreshQueue.end() - skipped - 1);
+		time_t          fresh = device->forced ? 0 : freshUntil( device );
+
+		skipped++;
+
+		// device is just being refreshed by another connection
+		if( device->busy )
+		{
+			continue;
+		}
+
+		if( fresh > actTime )
+		{
+			// passive data are good enough - check device again when the oldest value gets stale
+			time_t interval = device->stats.refreshInterval;
+
+			device->stats.refreshSkipped++;
+			device->nextRefresh = (interval && actTime + interval < fresh) ? actTime + interval : fresh;
+			continue;
+		}
+
+		/* check the time of last ADV packet to see, if the device is "near" */
+		if( device->advTimestamp < 0 || (actTime - device->advTimestamp) >= maxAdvTimeout )
+		{
+			continue;
+		}
+
+		// connection to device at the edge of range would most likely time out
+		if( device->forced == false && device->stats.rssi != 0.0 && device->stats.rssi < rssiFloor )
+		{
+			continue;
+		}
+
+		// device with unknown RSSI is taken only if there is no device with known RSSI
+		if( found == nullptr || (device->stats.rssi != 0.0 && (found->stats.rssi == 0.0 || device->stats.rssi > found->stats.rssi)) )
+		{
+			found = device;
+		}
+	}
+
+	if( found != nullptr && take )
+	{
+		refreshQueue.erase( std::find( refreshQueue.end() - skipped, refreshQueue.end(), found ) );
+		skipped--;
+		found->queued = false;
+		found->forced = false;
+	}
+
+	for( ; skipped > 0; skipped-- )
+	{
+		std::push_heap( refreshQueue.begin(), refreshQueue.end() - skipped + 1, refreshLater );
+	}
+
+	return found;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Hands device to idle connection of pool and wakes its worker task
+ * @param[in] conn Idle connection
+ * @param[in] device Device to refresh
+ * @param[in] actTime Actual time
+ */
+void LYWSD03MMC::startConnection( ConnContext *conn, LYWSD03MMCData *device, time_t actTime )
+{
+	SERIAL_PRINTF("Connecting and requesting data from sensor %s ...\n", device->alias );
+
+	time_t late = actTime - device->nextRefresh;
+
+	device->stats.refreshCount++;
+	device->stats.refreshLateLast = late;
+
+	if( late > device->stats.refreshLateMax )
+	{
+		device->stats.refreshLateMax = late;
+	}
+
+	scheduleRefresh( device, device->stats.refreshInterval ? actTime + device->stats.refreshInterval : 0 );
+
+	if( connBudget )
+	{
+		connTokens -= 1.0;
+	}
+
+	// listener lowers scan duty cycle (or pauses scan) while connections are active
+	connActive++;
+	bleAdvListener.connBegin();
+
+	device->busy = true;
+
+	conn->device = device;
+	conn->start = actTime;
+	conn->startMillis = millis();
+	conn->linkMillis = 0;
+	conn->haveData = false;
+	conn->readFailed = false;
+	conn->readTried = false;
+	conn->dataByRead = false;
+	conn->subscribed = false;
+	conn->histTried = false;
+	conn->histRecords.clear();
+	conn->state = CONN_CONNECTING;
+	xTaskNotifyGive( conn->task );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Changes refresh interval of device according to change of values since previous active refresh
+ * @param[in] device Device with received data
+ * @param[in] temp Received temperature
+ * @param[in] humidity Received humidity
+ */
+void LYWSD03MMC::adaptRefresh( LYWSD03MMCData *device, float temp, float humidity )
+{
+	time_t interval = device->stats.refreshInterval;
+	bool   first = (device->adaptHumidity < 0.0);
+	bool   stable = fabsf( temp - device->adaptTemp ) < tempThreshold && fabsf( humidity - device->adaptHumidity ) < humidityThreshold;
+
+	device->adaptTemp = temp;
+	device->adaptHumidity = humidity;
+
+	if( maxRefresh == 0 || interval == 0 || first )
+	{
+		return;
+	}
+
+	if( stable )
+	{
+		interval = (interval * 2 > maxRefresh) ? maxRefresh : interval * 2;
+	}
+	else
+	{
+		interval = (interval / 2 < minRefresh) ? minRefresh : interval / 2;
+	}
+
+	// interval 0 would mean no automatic refresh at all
+	if( interval < 1 )
+	{
+		interval = 1;
+	}
+
+	if( interval != device->stats.refreshInterval )
+	{
+		SERIAL_PRINTF("Refresh interval of sensor %s changed to %ld s\n", device->alias, (long) interval );
+
+		// next refresh was planned with previous interval when connection was started
+		if( device->queued )
+		{
+			scheduleRefresh( device, device->nextRefresh - device->stats.refreshInterval + interval );
+		}
+
+		device->stats.refreshInterval = interval;
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Refills connection budget and checks if another connection can be started
+ * @param[in] actTime Actual time
+ * @return Returns true if connection budget allows another connection
+ */
+bool LYWSD03MMC::budgetAllows( time_t actTime )
+{
+	if( connBudget == 0 )
+	{
+		return true;
+	}
+
+	// token bucket - refilled continuously, at most one hour of budget can be saved
+	connTokens += (float) (actTime - connTokensTime) * connBudget / 3600.0;
+	connTokensTime = actTime;
+
+	if( connTokens > connBudget )
+	{
+		connTokens = connBudget;
+	}
+
+	return connTokens >= 1.0;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Plans next connection attempt to device after failed connection
+ * @param[in] device Device with failed connection
+ * @param[in] actTime Actual time
+ */
+void LYWSD03MMC::planRetry( LYWSD03MMCData *device, time_t actTime )
+{
+	struct SensorStats *stats = &device->stats;
+	time_t              delay = stats->refreshInterval;
+
+	if( breakerThreshold && stats->connFailStreak >= breakerThreshold )
+	{
+		// device is only passive for some time - then one connection is tried again
+		if( stats->breakerOpen == false )
+		{
+			stats->breakerOpen = true;
+			stats->breakerTrips++;
+
+			SERIAL_PRINTF("Sensor %s is passive only after %u failed connections\n", device->alias, stats->connFailStreak );
+		}
+
+		delay = breakerTime;
+	}
+	else
+	{
+		for( uint32_t i = 1; i < stats->connFailStreak && delay < backoffMax; i++ )
+		{
+			delay *= 2;
+		}
+
+		if( delay > backoffMax )
+		{
+			delay = backoffMax;
+		}
+	}
+
+	stats->retryAt = actTime + delay;
+
+	// device without automatic refresh (forced refresh only) is not retried
+	if( device->queued && delay > stats->refreshInterval )
+	{
+		scheduleRefresh( device, stats->retryAt );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Takes result of finished connection, calls callbacks and returns connection to pool
+ * @param[in] conn Finished connection
+ */
+void LYWSD03MMC::finishConnection( ConnContext *conn )
+{
+	LYWSD03MMCData     *device = conn->device;
+	struct SensorStats *stats = &device->stats;
+
+	if( conn->linkMillis )
+	{
+		stats->linkCount++;
+		stats->linkTimeLast = conn->linkMillis;
+		stats->linkTimeTotal += conn->linkMillis;
+	}
+
+	if( conn->readTried && conn->dataByRead == false )
+	{
+		stats->readFailed++;
+	}
+
+	if( conn->haveData )
+	{
+		stats->connDataTimeLast = conn->dataMillis - conn->startMillis;
+
+		if( conn->dataByRead )
+		{
+			stats->readOk++;
+			stats->readTimeTotal += stats->connDataTimeLast;
+		}
+		else
+		{
+			stats->notifyOk++;
+			stats->notifyTimeTotal += stats->connDataTimeLast;
+		}
+
+		stats->connFailStreak = 0;
+		stats->breakerOpen = false;
+
+		adaptRefresh( device, conn->temp, conn->humidity );
+
+		setData( device, conn->temp, conn->humidity, conn->voltage );
+
+		if( conn->histTried )
+		{
+			if( device->pvvxCmdHandle )
+			{
+				mergePvvxLog( conn );
+			}
+			else
+			{
+				mergeHistory( conn );
+			}
+		}
+
+		SERIAL_PRINTF("Disconnected from sensor %s after data received\n", device->alias );
+	}
+	else
+	{
+		stats->connFailed++;
+		stats->connFailStreak++;
+
+		planRetry( device, time( NULL ) );
+
+		SERIAL_PRINTF("Disconnected from sensor %s due timeout\n", device->alias );
+	}
+
+	device->busy = false;
+	conn->device = nullptr;
+	conn->state = CONN_IDLE;
+
+	connActive--;
+	bleAdvListener.connEnd();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Merges history records received by finished connection to records of device
+ * @param[in] conn Finished connection
+ */
+void LYWSD03MMC::mergeHistory( ConnContext *conn )
+{
+	LYWSD03MMCData *device = conn->device;
+	uint32_t        next = conn->histStart;
+
+	// range was not received - backfill is tried again in next connection
+	if( conn->histNext <= conn->histFirst )
+	{
+		return;
+	}
+
+	for( auto it = conn->histRecords.cbegin(); it != conn->histRecords.cend(); it++ )
+	{
+		// sensor sends records in order - anything else is duplicate
+		if( it->index < next )
+		{
+			continue;
+		}
+
+		device->history.push_back( *it );
+		device->history.back().timestamp += conn->timeOffset;
+		device->stats.histRecords++;
+		next = it->index + 1;
+	}
+
+	device->histNextIndex = next;
+
+	// incomplete download is continued in next connection
+	if( next >= conn->histNext )
+	{
+		device->histFetched = conn->start;
+	}
+
+	if( device->history.size() > LYWSD03MMC_HISTORY_SIZE )
+	{
+		device->history.erase( device->history.begin(), device->history.end() - LYWSD03MMC_HISTORY_SIZE );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Merges log records of pvvx firmware received by finished connection to records of device
+ * @param[in] conn Finished connection
+ */
+void LYWSD03MMC::mergePvvxLog( ConnContext *conn )
+{
+	LYWSD03MMCData *device = conn->device;
+
+	// time was not received - log was not requested and backfill is tried again in next connection
+	if( conn->sensorTime == 0 )
+	{
+		return;
+	}
+
+	// records are received from the newest one - older records missed by timeout are not requested again,
+	// next connection continues after the newest one
+	for( auto it = conn->histRecords.crbegin(); it != conn->histRecords.crend(); it++ )
+	{
+		device->history.push_back( *it );
+		device->history.back().timestamp += conn->timeOffset;
+		device->stats.histRecords++;
+	}
+
+	if( conn->histRecords.empty() == false )
+	{
+		device->histLastTime = conn->histRecords.front().timestamp;
+	}
+	else
+	{
+		device->histLastTime = conn->histAfter;
+	}
+
+	// unfinished download is tried again in next connection
+	if( conn->histDone )
+	{
+		device->histFetched = conn->start;
+	}
+
+	if( device->history.size() > LYWSD03MMC_HISTORY_SIZE )
+	{
+		device->history.erase( device->history.begin(), device->history.end() - LYWSD03MMC_HISTORY_SIZE );
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Method to handle everything needed - should be called in every loop() iteration
+ */
+void LYWSD03MMC::process()
+{
+	time_t actTime = time( NULL );
+
+	// listener decides if scan and connection can run at the same time
+	bool   canConnect = bleAdvListener.canConnect();
+	bool   haveDue = true;
+
+	for( uint8_t i = 0; i < connCount; i++ )
+	{
+		ConnContext *conn = &conns[i];
+
+		if( conn->state == CONN_DONE )
+		{
+			finishConnection( conn );
+		}
+
+		// other states - worker task is working with device, nothing to do here
+		if( conn->state == CONN_IDLE && haveDue && budgetAllows( actTime ) )
+		{
+			if( canConnect == false )
+			{
+				// scan has to be finished or stopped first - only when some device is really waiting for connection
+				if( takeDueDevice( actTime, false ) != nullptr )
+				{
+					bleAdvListener.connPrepare();
+				}
+
+				haveDue = false;
+			}
+			else
+			{
+				LYWSD03MMCData *actDevice = takeDueDevice( actTime );
+
+				if( actDevice != nullptr )
+				{
+					startConnection( conn, actDevice, actTime );
+				}
+				else
+				{
+					haveDue = false;
+				}
+			}
+		}
+	}
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Registers new LYWSD03MMC devices MAC address that we want to get data from
+ * @param[in] address MAC address of device
+ * @param[in] alias Our device alias
+ * @param[in] key Key for decrypting ADV packets in passive mode
+ */
+void LYWSD03MMC::deviceRegister( BLEAddress *address, const char *alias, const uint8_t *key )
+{
+	LYWSD03MMCData *data = new LYWSD03MMCData( address, alias, key );
+
+	data->stats.refreshInterval = refreshTime;
+
+	if( refreshTime )
+	{
+		scheduleRefresh( data, 1 + std::distance( regDevices.cbegin(), regDevices.cend() ) * (connTimeout * 2) );
+	}
+
+	data->cbkWaitTime = cbkWaitTime;
+	data->regCbks = &regCbks;
+	bleAdvListener.cbkRegister( address, data );
 
 	regDevices.push_front( data );
 }
 
+/* ************************************************************************** */
+/**
+ * @brief Sets freshness budget for hybrid passive/active mode. Planned connection to device is skipped,
+ * when every value received from ADV packets (or previous connection) is younger than its budget.
+ * Forced refresh always connects.
+ * @param[in] tempBudget Max. age of temperature in seconds (0 = always connect - default)
+ * @param[in] humidityBudget Max. age of humidity in seconds (0 = always connect - default)
+ * @param[in] batBudget Max. age of battery info in seconds (0 = always connect - default)
+ */
+void LYWSD03MMC::setFreshBudget( time_t tempBudget, time_t humidityBudget, time_t batBudget )
+{
+	this->tempBudget = tempBudget;
+	this->humidityBudget = humidityBudget;
+	this->batBudget = batBudget;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Enables direct read of data characteristic right after connection. When read fails,
+ * data are requested by notification as before.
+ * @param[in] directRead true for direct read, false for notification only (default)
+ */
+void LYWSD03MMC::setDirectRead( bool directRead )
+{
+	this->directRead = directRead;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets behaviour after failed connections. After each failure next attempt is delayed by refresh time
+ * doubled for every consecutive failure (up to backoffMax). After breakerThreshold consecutive failures
+ * device is passive only (no connections) for breakerTime, then one connection is tried again.
+ * @param[in] backoffMax Max. delay between attempts in seconds (default 3600)
+ * @param[in] breakerThreshold Number of consecutive failures for passive only mode (0 = never, default 5)
+ * @param[in] breakerTime Time of passive only mode in seconds (default 3600)
+ */
+void LYWSD03MMC::setBackoff( time_t backoffMax, uint8_t breakerThreshold, time_t breakerTime )
+{
+	this->backoffMax = backoffMax;
+	this->breakerThreshold = breakerThreshold;
+	this->breakerTime = breakerTime;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets connection parameters profile. Fast parameters are requested right after connection
+ * for discovery and reading, slow parameters when we wait for notification from sensor.
+ * Connection is closed immediately after data are received.
+ * @param[in] fast Parameters for discovery and reading (default 7.5 - 15ms interval)
+ * @param[in] slow Parameters for waiting for notification (default - not changed)
+ */
+void LYWSD03MMC::setConnProfile( const LYWSD03MMCConnParams &fast, const LYWSD03MMCConnParams &slow )
+{
+	fastParams = fast;
+	slowParams = slow;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Enables adaptive refresh. Refresh interval of device is doubled when values from two consecutive
+ * active refreshes differ less than thresholds, and halved when they differ more.
+ * @param[in] minRefresh Min. refresh interval in seconds (at least 1, at most maxRefresh)
+ * @param[in] maxRefresh Max. refresh interval in seconds (0 = adaptive refresh disabled - default)
+ * @param[in] tempThreshold Change of temperature considered as stable
+ * @param[in] humidityThreshold Change of humidity considered as stable
+ */
+void LYWSD03MMC::setAdaptiveRefresh( time_t minRefresh, time_t maxRefresh, float tempThreshold, float humidityThreshold )
+{
+	if( minRefresh < 1 )
+	{
+		minRefresh = 1;
+	}
+
+	if( maxRefresh && minRefresh > maxRefresh )
+	{
+		minRefresh = maxRefresh;
+	}
+
+	this->minRefresh = minRefresh;
+	this->maxRefresh = maxRefresh;
+	this->tempThreshold = tempThreshold;
+	this->humidityThreshold = humidityThreshold;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Limits number of connections to all devices per hour. When budget is used up,
+ * due refreshes wait until it is refilled.
+ * @param[in] connsPerHour Max. number of connections per hour (0 = unlimited - default)
+ */
+void LYWSD03MMC::setConnBudget( uint16_t connsPerHour )
+{
+	connBudget = connsPerHour;
+	connTokens = connsPerHour;
+	connTokensTime = time( NULL );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Sets min. smoothed RSSI of device for connection. Weaker devices are not connected
+ * (unless refresh is forced). Among due devices, the one with the strongest signal is connected first.
+ * @param[in] rssiFloor Min. RSSI in dBm (-127 = no limit - default)
+ */
+void LYWSD03MMC::setRssiFloor( int8_t rssiFloor )
+{
+	this->rssiFloor = rssiFloor;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Enables backfill of history. Once per hour (and after reboot or outage) hourly min/max records (log records of pvvx firmware)
+ * not fetched yet are downloaded from sensor memory in the same connection as actual data. Their timestamps are converted
+ * from sensor clock to gateway clock.
+ * @param[in] maxRecords Max. number of records downloaded in one connection (0 = backfill disabled - default)
+ * @param[in] timeout Max. time of download in seconds
+ */
+void LYWSD03MMC::setBackfill( uint16_t maxRecords, time_t timeout )
+{
+	this->backfillMax = maxRecords;
+	this->backfillTimeout = timeout;
+}
+
 /* ************************************************************************** */
 /**
  * @brief Forces data refresh of device by alias
@@ -653,7 +1728,8 @@ void LYWSD03MMC::forceRefresh( const char *alias )
 	{
 		if( (*it)->alias && strcmp( (*it)->alias, alias ) == 0 )
 		{
-			(*it)->nextRefresh = time( NULL );
+			(*it)->forced = true;
+			scheduleRefresh( *it, time( NULL ) );
 			break;
 		}
 	}
@@ -670,7 +1746,8 @@ void LYWSD03MMC::forceRefresh( BLEAddress &address )
 	{
 		if( (*it)->address->equals( address ) == true )
 		{
-			(*it)->nextRefresh = time( NULL );
+			(*it)->forced = true;
+			scheduleRefresh( *it, time( NULL ) );
 			break;
 		}
 	}
@@ -720,6 +1797,109 @@ bool LYWSD03MMC::getData( BLEAddress &address, struct SensorValues *values )
 	return false;
 }
 
+/* ************************************************************************** */
+/**
+ * @brief Gets device statistics by alias
+ * @param[in] alias Alias of device we are interested in
+ * @param[out] stats Statistics for sensor with given alias
+ * @return Returns true if device with entered alias was found (registered)
+ */
+bool LYWSD03MMC::getStats( const char *alias, struct SensorStats *stats )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->alias && strcmp( (*it)->alias, alias ) == 0 )
+		{
+			*stats = (*it)->stats;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Gets device statistics by address
+ * @param[in] address Address of device we are interested in
+ * @param[out] stats Statistics for sensor with given address
+ * @return Returns true if device with entered address was found (registered)
+ */
+bool LYWSD03MMC::getStats( BLEAddress &address, struct SensorStats *stats )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->address->equals( address ) == true )
+		{
+			*stats = (*it)->stats;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Copies newest history records of device
+ * @param[in] device Device we are interested in
+ * @param[out] records Newest records of device (oldest first)
+ * @param[in] maxCount Max. number of records to copy
+ * @return Returns number of copied records
+ */
+size_t LYWSD03MMC::copyHistory( const LYWSD03MMCData *device, LYWSD03MMCHistory *records, size_t maxCount )
+{
+	size_t count = std::min( maxCount, device->history.size() );
+
+	std::copy( device->history.end() - count, device->history.end(), records );
+
+	return count;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Gets history records fetched from sensor memory by alias
+ * @param[in] alias Alias of device we are interested in
+ * @param[out] records Newest records of device (oldest first)
+ * @param[in] maxCount Max. number of records to return
+ * @return Returns number of returned records
+ */
+size_t LYWSD03MMC::getHistory( const char *alias, LYWSD03MMCHistory *records, size_t maxCount )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->alias && strcmp( (*it)->alias, alias ) == 0 )
+		{
+			return copyHistory( *it, records, maxCount );
+		}
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Gets history records fetched from sensor memory by MAC address
+ * @param[in] address Address of device we are interested in
+ * @param[out] records Newest records of device (oldest first)
+ * @param[in] maxCount Max. number of records to return
+ * @return Returns number of returned records
+ */
+size_t LYWSD03MMC::getHistory( BLEAddress &address, LYWSD03MMCHistory *records, size_t maxCount )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->address->equals( address ) == true )
+		{
+			return copyHistory( *it, records, maxCount );
+		}
+	}
+
+	return 0;
+}
+
 /* ************************************************************************** */
 /**
  * @brief Registers new callback called on data refresh
@@ -1,16 +1,38 @@
 #pragma once
 
 #include "Arduino.h"
-#include <BLEDevice.h>
+#include "BleTransport.h"
 #include "BleAdvListener.h"
 #include "SensorCommon.h"
+#include "mbedtls/ccm.h"
 #include <forward_list>
+#include <vector>
+#include <atomic>
+
+#define LYWSD03MMC_MAX_CONNS  3 // max. number of concurrent connections (default limit of ESP32 BT controller)
+
+#define LYWSD03MMC_HISTORY_SIZE    48   // max. number of history records stored for one device
+#define LYWSD03MMC_HISTORY_PERIOD  3600 // sensor stores one history record per hour
+
+/* ************************************************************************** */
+/**
+ * @brief One record of hourly min/max history stored in sensor memory
+ */
+struct LYWSD03MMCHistory
+{
+	uint32_t     index = 0;       // index of record in sensor memory (number of record in log of pvvx firmware)
+	time_t       timestamp = 0;   // start of hour (time of measurement in log of pvvx firmware) by gateway clock
+	float        tempMax = 0.0;
+	float        humidityMax = 0.0;
+	float        tempMin = 0.0;
+	float        humidityMin = 0.0;
+};
 
 /* ************************************************************************** */
 /**
  * @brief Class with data from one LYWSD03MMC sensor
  */
-class LYWSD03MMCData : public BleAdvListenerCbk
+class LYWSD03MMCData : public BleAdvListenerCbk, private SensorState
 {
 private:
 	BLEAddress  *address;
@@ -19,14 +41,35 @@ private:
 
 	const uint8_t *key;
 
+	mbedtls_ccm_context ccm;  // CCM context with expanded key - prepared once, used for every encrypted frame
+	bool         ccmReady = false;
+
 	time_t       advTimestamp = -1; // timestamp of last ADV packet received
 	time_t       nextRefresh = 0;   // next planed data refresh
-	time_t       cbkWaitTime = 0;
-	time_t       nextTempNotify = 0;
-	time_t       nextHumidityNotify = 0;
-	time_t       nextBatNotify = 0;
-
-	struct SensorValues values;
+	bool         queued = false;    // device is in refresh queue
+	bool         forced = false;    // refresh was forced - connect even when passive data are fresh
+	bool         busy = false;      // device is handed to connection worker task
+	float        adaptTemp = -100.0;   // temperature from previous active refresh (for adaptive refresh)
+	float        adaptHumidity = -1.0; // humidity from previous active refresh (for adaptive refresh)
+	uint16_t     charHandle = 0;    // cached handle of data characteristic (0 = not discovered yet)
+	uint16_t     cccdHandle = 0;    // cached handle of client characteristic configuration descriptor of data characteristic
+	uint16_t     commHandle = 0;    // cached handle of communication interval characteristic
+	uint16_t     histRangeHandle = 0; // cached handle of history range characteristic (0 = firmware without history)
+	uint16_t     histIndexHandle = 0; // cached handle of history start index characteristic
+	uint16_t     histDataHandle = 0;  // cached handle of history records characteristic
+	uint16_t     histCccdHandle = 0;  // cached handle of client characteristic configuration descriptor of history records
+	uint16_t     timeHandle = 0;      // cached handle of sensor time characteristic
+	uint16_t     pvvxCmdHandle = 0;   // cached handle of command characteristic of pvvx firmware (0 = other firmware)
+	uint16_t     pvvxCccdHandle = 0;  // cached handle of client characteristic configuration descriptor of pvvx commands
+	uint32_t     histNextIndex = 0; // index of first history record not fetched yet
+	uint32_t     histLastTime = 0;  // sensor time of the newest fetched record of pvvx log
+	time_t       histFetched = 0;   // time when all history records were fetched (0 = never)
+
+	struct SensorStats stats;
+
+	AdvDupCache  dupCache; // last frames received from device
+
+	std::vector<LYWSD03MMCHistory> history; // history records fetched from sensor memory (oldest first)
 
 	std::forward_list<SensorDataChangeCbk *> *regCbks = nullptr; // list with registered callbacks
 public:
@@ -37,29 +80,60 @@ public:
 		this->alias = alias;
 		this->key = key;
 
-		memset( &values, 0, sizeof( struct SensorValues ) );
+		mbedtls_ccm_init( &ccm );
+
+		if( key != nullptr )
+		{
+			ccmReady = (mbedtls_ccm_setkey( &ccm, MBEDTLS_CIPHER_ID_AES, key, 16 * 8 ) == 0);
+		}
 	}
 
+	~LYWSD03MMCData()
+	{
+		mbedtls_ccm_free( &ccm );
+	}
+
+	// CCM context owns expanded key - copy would free it twice
+	LYWSD03MMCData( const LYWSD03MMCData & ) = delete;
+	LYWSD03MMCData &operator=( const LYWSD03MMCData & ) = delete;
+
 	/**
 	 * @brief Method called when ADV packet is received
 	 * @param[in] address Address of advertised device
 	 * @param[in] serviceDataUUID UUID of advertised service data
 	 * @param[in] serviceData Service data from ADV packet
 	 */
-	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std::string &serviceData );
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData );
 
 	/**
 	 * @brief Decrypts encrypted ADV service data
 	 * @param[in] serviceData Received encrypted service data
-	 * @param[in] key Key to decrypt data
-	 * @param[out] decryptedData Decrypted data (if success)
+	 * @param[out] decryptedData Decrypted MiBeacon objects (if success)
+	 * @param[out] decryptedLength Length of decrypted objects
 	 * @return Returns true on success or false on failure
 	 */
-	bool decryptServiceData( std::string &serviceData, const uint8_t *key, uint8_t decryptedData[16] );
+	bool decryptServiceData( const AdvDataView &serviceData, uint8_t decryptedData[16], size_t *decryptedLength );
 
 	friend class LYWSD03MMC;
 };
 
+/* ************************************************************************** */
+/**
+ * @brief Parameters of BLE connection requested by GAP connection parameter update
+ */
+struct LYWSD03MMCConnParams
+{
+	uint16_t     minInterval = 0; // min. connection interval in 1.25ms units (0 = parameters are not changed)
+	uint16_t     maxInterval = 0; // max. connection interval in 1.25ms units
+	uint16_t     latency = 0;     // slave latency in connection events
+	uint16_t     timeout = 0;     // supervision timeout in 10ms units
+
+	LYWSD03MMCConnParams() {}
+
+	LYWSD03MMCConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout )
+		: minInterval( minInterval ), maxInterval( maxInterval ), latency( latency ), timeout( timeout ) {}
+};
+
 /* ************************************************************************** */
 
 /**
@@ -73,20 +147,21 @@ public:
 	 * @brief Initialise class. Call it if you have already initialised bluetooth client.
 	 * This method must be called once before any other calls (in setup() function).
 	 *
-	 * @param[in] client Bluetooth client class
+	 * @param[in] client GATT client of BLE transport
 	 * @param[in] refreshTime Time in seconds in which data will be automaticaly refreshed (0 = no automatic refresh)
 	 * @param[in] cbkWaitTime Minimum time in seconds between two callback calls for the same sensor value update
 	 */
-	void init( BLEClient *client, time_t refreshTime = 300, time_t cbkWaitTime = 10 );
+	void init( BleGattClient *client, time_t refreshTime = 300, time_t cbkWaitTime = 10 );
 
 	/**
-	 * @brief Initialise class. Call it if you don't have initialised bluetooth client. Method will initialise one client for you.
+	 * @brief Initialise class. Call it if you don't have initialised bluetooth client. Method will initialise clients for you.
 	 * This method must be called once before any other calls (in setup() funcion)
 	 *
 	 * @param[in] refreshTime Time in seconds in which data will be automaticaly refreshed (0 = no automatic refresh)
 	 * @param[in] cbkWaitTime Minimum time in seconds between two callback calls for the same sensor value update
+	 * @param[in] poolSize Number of concurrent connections (1 - LYWSD03MMC_MAX_CONNS)
 	 */
-	void init( time_t refreshTime = 300, time_t cbkWaitTime = 10 );
+	void init( time_t refreshTime = 300, time_t cbkWaitTime = 10, uint8_t poolSize = 1 );
 
 	/**
 	 * @brief Method to handle everything needed - should be called in every loop() iteration
@@ -129,89 +204,452 @@ public:
 	 */
 	bool getData( BLEAddress &address, struct SensorValues *values );
 
+	/**
+	 * @brief Gets device statistics by alias
+	 * @param[in] alias Alias of device we are interested in
+	 * @param[out] stats Statistics for sensor with given alias
+	 * @return Returns true if device with entered alias was found (registered)
+	 */
+	bool getStats( const char *alias, struct SensorStats *stats );
+
+	/**
+	 * @brief Gets device statistics by MAC address
+	 * @param[in] address Address of device we are interested in
+	 * @param[out] stats Statistics for sensor with given address
+	 * @return Returns true if device with entered MAC was found (registered)
+	 */
+	bool getStats( BLEAddress &address, struct SensorStats *stats );
+
 	/**
 	 * @brief Registers new callback called on data refresh
 	 * @param[in] cbk Pointer to callback class
 	 */
 	void cbkRegister( SensorDataChangeCbk *cbk );
 
+	/**
+	 * @brief Parses value of data characteristic
+	 * @param[in] data Value of characteristic
+	 * @param[in] dataLength Length of value
+	 * @param[out] temp Temperature
+	 * @param[out] humidity Humidity
+	 * @param[out] voltage Battery voltage
+	 * @return Returns false if value is too short
+	 */
+	static bool parseData( const uint8_t *data, size_t dataLength, float *temp, float *humidity, float *voltage );
+
+	/**
+	 * @brief Parses one record of history records characteristic
+	 * @param[in] data Value of characteristic
+	 * @param[in] dataLength Length of value
+	 * @param[out] record Parsed record
+	 * @return Returns false if value is too short
+	 */
+	static bool parseHistoryRecord( const uint8_t *data, size_t dataLength, LYWSD03MMCHistory *record );
+
+	/**
+	 * @brief Parses one record of log sent by pvvx firmware as response to log command
+	 * @param[in] data Value of command characteristic
+	 * @param[in] dataLength Length of value
+	 * @param[out] record Parsed record - measured values are both min and max, timestamp is by sensor clock
+	 * @return Returns false if value is not log record (e.g. end of log)
+	 */
+	static bool parsePvvxLogRecord( const uint8_t *data, size_t dataLength, LYWSD03MMCHistory *record );
+
+	/**
+	 * @brief Sets freshness budget for hybrid passive/active mode. Planned connection to device is skipped,
+	 * when every value received from ADV packets (or previous connection) is younger than its budget.
+	 * Forced refresh always connects.
+	 * @param[in] tempBudget Max. age of temperature in seconds (0 = always connect - default)
+	 * @param[in] humidityBudget Max. age of humidity in seconds (0 = always connect - default)
+	 * @param[in] batBudget Max. age of battery info in seconds (0 = always connect - default)
+	 */
+	void setFreshBudget( time_t tempBudget, time_t humidityBudget, time_t batBudget );
+
+	/**
+	 * @brief Enables direct read of data characteristic right after connection. When read fails,
+	 * data are requested by notification as before.
+	 * @param[in] directRead true for direct read, false for notification only (default)
+	 */
+	void setDirectRead( bool directRead );
+
+	/**
+	 * @brief Sets behaviour after failed connections. After each failure next attempt is delayed by refresh time
+	 * doubled for every consecutive failure (up to backoffMax). After breakerThreshold consecutive failures
+	 * device is passive only (no connections) for breakerTime, then one connection is tried again.
+	 * @param[in] backoffMax Max. delay between attempts in seconds (default 3600)
+	 * @param[in] breakerThreshold Number of consecutive failures for passive only mode (0 = never, default 5)
+	 * @param[in] breakerTime Time of passive only mode in seconds (default 3600)
+	 */
+	void setBackoff( time_t backoffMax, uint8_t breakerThreshold, time_t breakerTime );
+
+	/**
+	 * @brief Sets connection parameters profile. Fast parameters are requested right after connection
+	 * for discovery and reading, slow parameters when we wait for notification from sensor.
+	 * Connection is closed immediately after data are received.
+	 * @param[in] fast Parameters for discovery and reading (default 7.5 - 15ms interval)
+	 * @param[in] slow Parameters for waiting for notification (default - not changed)
+	 */
+	void setConnProfile( const LYWSD03MMCConnParams &fast, const LYWSD03MMCConnParams &slow );
+
+	/**
+	 * @brief Enables adaptive refresh. Refresh interval of device is doubled when values from two consecutive
+	 * active refreshes differ less than thresholds, and halved when they differ more.
+	 * @param[in] minRefresh Min. refresh interval in seconds (at least 1, at most maxRefresh)
+	 * @param[in] maxRefresh Max. refresh interval in seconds (0 = adaptive refresh disabled - default)
+	 * @param[in] tempThreshold Change of temperature considered as stable
+	 * @param[in] humidityThreshold Change of humidity considered as stable
+	 */
+	void setAdaptiveRefresh( time_t minRefresh, time_t maxRefresh, float tempThreshold, float humidityThreshold );
+
+	/**
+	 * @brief Limits number of connections to all devices per hour. When budget is used up,
+	 * due refreshes wait until it is refilled.
+	 * @param[in] connsPerHour Max. number of connections per hour (0 = unlimited - default)
+	 */
+	void setConnBudget( uint16_t connsPerHour );
+
+	/**
+	 * @brief Sets min. smoothed RSSI of device for connection. Weaker devices are not connected
+	 * (unless refresh is forced). Among due devices, the one with the strongest signal is connected first.
+	 * @param[in] rssiFloor Min. RSSI in dBm (-127 = no limit - default)
+	 */
+	void setRssiFloor( int8_t rssiFloor );
+
+	/**
+	 * @brief Enables backfill of history. Once per hour (and after reboot or outage) hourly min/max records (log records of pvvx firmware)
+	 * not fetched yet are downloaded from sensor memory in the same connection as actual data. Their timestamps are converted
+	 * from sensor clock to gateway clock.
+	 * @param[in] maxRecords Max. number of records downloaded in one connection (0 = backfill disabled - default)
+	 * @param[in] timeout Max. time of download in seconds
+	 */
+	void setBackfill( uint16_t maxRecords, time_t timeout = 30 );
+
+	/**
+	 * @brief Gets history records fetched from sensor memory by alias
+	 * @param[in] alias Alias of device we are interested in
+	 * @param[out] records Newest records of device (oldest first)
+	 * @param[in] maxCount Max. number of records to return
+	 * @return Returns number of returned records
+	 */
+	size_t getHistory( const char *alias, LYWSD03MMCHistory *records, size_t maxCount );
+
+	/**
+	 * @brief Gets history records fetched from sensor memory by MAC address
+	 * @param[in] address Address of device we are interested in
+	 * @param[out] records Newest records of device (oldest first)
+	 * @param[in] maxCount Max. number of records to return
+	 * @return Returns number of returned records
+	 */
+	size_t getHistory( BLEAddress &address, LYWSD03MMCHistory *records, size_t maxCount );
 
 private:
-	enum
+	enum ConnState
 	{
-		ST_NOT_CONNECTED,       // we are not connected do any device
-		ST_WAITING_FOR_DATA,    // we are connected to device and we are waiting for notification data
-		ST_HAVE_DATA_CONNECTED, // we are connected and we have received notification data
-	} state;
+		CONN_IDLE,        // we are not connected do any device - worker task waits for request
+		CONN_CONNECTING,  // worker task is connecting to device
+		CONN_DISCOVERING, // worker task is looking for service and characteristic
+		CONN_READING,     // worker task is reading data characteristic directly
+		CONN_SUBSCRIBING, // worker task is enabling notifications
+		CONN_WAITING,     // we are connected to device and we are waiting for notification data
+		CONN_HISTORY,     // worker task is downloading history records
+		CONN_TEARDOWN,    // worker task is disabling notifications and disconnecting
+		CONN_DONE,        // connection is finished - result is waiting for process()
+	};
 
-	BLEClient *bleClient = nullptr;
+	/**
+	 * @brief Context of one connection from pool - shared between process() and its worker task
+	 */
+	struct ConnContext : public BleGattClientCbk
+	{
+		LYWSD03MMC   *owner = nullptr;
+		BleGattClient *client = nullptr;  // client used by this connection
+		TaskHandle_t task = nullptr;      // worker task doing blocking GATT client calls
+		std::atomic<LYWSD03MMCData *> device; // device we are working with - set by process() before connection starts, read also by BT task
+		std::atomic<ConnState> state;     // only process() moves state from CONN_IDLE and CONN_DONE, all other moves are done by worker
+		std::atomic<bool> haveData;       // data were received
+		std::atomic<bool> readFailed;     // direct read was answered with error
+		std::atomic<bool> histDone;       // history range or all requested history records were received
+		bool         readTried = false;   // direct read was requested
+		bool         dataByRead = false;  // data were received by direct read (not by notification)
+		bool         subscribed = false;  // notifications were enabled
+		bool         histTried = false;   // history range was requested
+		uint32_t     histFirst = 0;       // index of the oldest record in sensor memory
+		uint32_t     histNext = 0;        // index of the next record sensor will store (0 = range not received)
+		uint32_t     histStart = 0;       // index of the first requested record
+		uint32_t     histAfter = 0;       // sensor time of the newest pvvx log record already fetched
+		std::atomic<uint32_t> sensorTime; // sensor clock read in this connection (0 = not received)
+		time_t       timeOffset = 0;      // gateway clock minus sensor clock
+		std::vector<LYWSD03MMCHistory> histRecords; // records received in this connection
+		time_t       start = 0;           // time when connection was requested
+		uint32_t     startMillis = 0;     // millis() when connection was requested
+		uint32_t     dataMillis = 0;      // millis() when data were received
+		uint32_t     linkMillis = 0;      // duration of connection from connect to disconnect (ms)
+		float        temp = 0.0;
+		float        humidity = 0.0;
+		float        voltage = 0.0;
+
+		ConnContext() : device( nullptr ), state( CONN_IDLE ), haveData( false ), readFailed( false ), histDone( false ), sensorTime( 0 ) {}
+
+		/**
+		 * @brief Method called by GATT client when notification is received (called from BT task)
+		 * @param[in] handle Handle of characteristic
+		 * @param[in] data Value of characteristic
+		 * @param[in] length Length of value
+		 */
+		void onNotify( uint16_t handle, const uint8_t *data, size_t length );
+
+		/**
+		 * @brief Method called by GATT client when read requested by read() is finished (called from BT task)
+		 * @param[in] handle Handle of characteristic
+		 * @param[in] ok true if read succeeded, false if it was answered with error
+		 * @param[in] data Value of characteristic
+		 * @param[in] length Length of value
+		 */
+		void onRead( uint16_t handle, bool ok, const uint8_t *data, size_t length );
+	};
+
+	ConnContext conns[LYWSD03MMC_MAX_CONNS]; // pool of connections
+	uint8_t     connCount = 0;               // number of connections in pool
+	uint8_t     connActive = 0;              // number of connections with device
 
 	std::forward_list<LYWSD03MMCData *> regDevices; // list with registered devices
 
 	std::forward_list<SensorDataChangeCbk *> regCbks; // list with registered callbacks
 
-	// actual device we are working with (due to library limitation we can be connected only to one device at a time)
-	LYWSD03MMCData *actDevice = nullptr;
+	std::vector<LYWSD03MMCData *> refreshQueue; // min-heap of devices ordered by nextRefresh
 
-	time_t connStart;
 	time_t connTimeout = 15;
 	time_t maxAdvTimeout = 30;
 	time_t refreshTime;
 	time_t cbkWaitTime;
+	time_t tempBudget = 0;
+	time_t humidityBudget = 0;
+	time_t batBudget = 0;
+	bool   directRead = false;
+	time_t backoffMax = 3600;
+	uint8_t breakerThreshold = 5;
+	time_t breakerTime = 3600;
+	LYWSD03MMCConnParams fastParams = LYWSD03MMCConnParams( 6, 12, 0, 300 ); // 7.5 - 15ms interval, 3s supervision timeout - connection lasts only few hundreds of ms
+	LYWSD03MMCConnParams slowParams;
+	time_t minRefresh = 0;
+	time_t maxRefresh = 0;
+	float  tempThreshold = 0.0;
+	float  humidityThreshold = 0.0;
+	uint16_t connBudget = 0;      // max. connections per hour (0 = unlimited)
+	int8_t   rssiFloor = -127;    // min. RSSI of device for connection
+	float    connTokens = 0.0;    // connections available now (token bucket refilled by connBudget)
+	time_t   connTokensTime = 0;  // time of last refill of connTokens
+	uint32_t readTimeout = 1000; // max. time for direct read in ms - then notification is used
+	uint16_t backfillMax = 0;     // max. history records downloaded in one connection (0 = backfill disabled)
+	time_t   backfillTimeout = 30; // max. time of history download in seconds
+
+	/**
+	 * @brief Plans next data refresh of device
+	 * @param[in] device Device to refresh
+	 * @param[in] nextRefresh Time of refresh (0 = no refresh)
+	 */
+	void scheduleRefresh( LYWSD03MMCData *device, time_t nextRefresh );
 
 	/**
-	 * @brief Callback called when notification from sensor is received
-	 * @param[in] pBLERemoteCharacteristic Registered characteristics
-	 * @param[in] data Data received in notification
+	 * @brief Compares devices by planned refresh - used for min-heap of devices
+	 */
+	static bool refreshLater( const LYWSD03MMCData *a, const LYWSD03MMCData *b );
+
+	/**
+	 * @brief Computes time until which are all values of device fresh enough to skip connection
+	 * @param[in] device Device to check
+	 * @return Returns time when the oldest value exceeds its budget (0 = hybrid mode is disabled)
+	 */
+	time_t freshUntil( const LYWSD03MMCData *device );
+
+	/**
+	 * @brief Takes device with the strongest signal from devices which are due, near (ADV packet received recently,
+	 * RSSI above floor) and whose passive data are not fresh. Devices with fresh data are planned again on time
+	 * when data becomes stale.
+	 * @param[in] actTime Actual time
+	 * @param[in] take false only checks that there is such device - it stays in queue
+	 * @return Returns device to refresh or nullptr if there is no such device
+	 */
+	LYWSD03MMCData *takeDueDevice( time_t actTime, bool take = true );
+
+	/**
+	 * @brief Adds connection with given client to pool and starts its worker task
+	 * @param[in] client GATT client of BLE transport
+	 */
+	void addConn( BleGattClient *client );
+
+	/**
+	 * @brief Hands device to idle connection of pool and wakes its worker task
+	 * @param[in] conn Idle connection
+	 * @param[in] device Device to refresh
+	 * @param[in] actTime Actual time
+	 */
+	void startConnection( ConnContext *conn, LYWSD03MMCData *device, time_t actTime );
+
+	/**
+	 * @brief Changes refresh interval of device according to change of values since previous active refresh
+	 * @param[in] device Device with received data
+	 * @param[in] temp Received temperature
+	 * @param[in] humidity Received humidity
+	 */
+	void adaptRefresh( LYWSD03MMCData *device, float temp, float humidity );
+
+	/**
+	 * @brief Refills connection budget and checks if another connection can be started
+	 * @param[in] actTime Actual time
+	 * @return Returns true if connection budget allows another connection
+	 */
+	bool budgetAllows( time_t actTime );
+
+	/**
+	 * @brief Plans next connection attempt to device after failed connection
+	 * @param[in] device Device with failed connection
+	 * @param[in] actTime Actual time
+	 */
+	void planRetry( LYWSD03MMCData *device, time_t actTime );
+
+	/**
+	 * @brief Takes result of finished connection, calls callbacks and returns connection to pool
+	 * @param[in] conn Finished connection
+	 */
+	void finishConnection( ConnContext *conn );
+
+	/**
+	 * @brief Callback called when data from sensor are received (by notification or direct read)
+	 * @param[in] conn Connection with received data
+	 * @param[in] data Received data
 	 * @param[in] dataLength Length of received data
-	 * @param[in] isNotify True when notification was received
 	 */
-	static void notifyCallback( BLERemoteCharacteristic *pBLERemoteCharacteristic,
-			uint8_t *data, size_t dataLength, bool isNotify );
+	static void notifyCallback( ConnContext *conn, const uint8_t *data, size_t dataLength );
 
 	/**
-	 * @brief Registers @notifyCallback for notifications from sensor
+	 * @brief Callback called when history record from sensor is received (called from BT task)
+	 * @param[in] conn Connection with received record
+	 * @param[in] data Received record
+	 * @param[in] dataLength Length of received record
+	 */
+	static void historyCallback( ConnContext *conn, const uint8_t *data, size_t dataLength );
+
+	/**
+	 * @brief Callback called when response to command of pvvx firmware is received (called from BT task)
+	 * @param[in] conn Connection with received response
+	 * @param[in] data Received response
+	 * @param[in] dataLength Length of received response
+	 */
+	static void pvvxCallback( ConnContext *conn, const uint8_t *data, size_t dataLength );
+
+	/**
+	 * @brief Downloads history records not fetched yet from sensor memory (called from worker task)
+	 * @param[in] conn Connection to use
+	 */
+	void backfillHistory( ConnContext *conn );
+
+	/**
+	 * @brief Downloads log records not fetched yet from memory of sensor with pvvx firmware (called from worker task)
+	 * @param[in] conn Connection to use
+	 * @param[in] deadline Tick count when download ends
+	 */
+	void backfillPvvxLog( ConnContext *conn, TickType_t deadline );
+
+	/**
+	 * @brief Waits in worker task until history range or all requested records are received or deadline expires
+	 * @param[in] conn Connection to wait for
+	 * @param[in] deadline Tick count when waiting ends
+	 */
+	void waitForHistory( ConnContext *conn, TickType_t deadline );
+
+	/**
+	 * @brief Merges history records received by finished connection to records of device
+	 * @param[in] conn Finished connection
+	 */
+	void mergeHistory( ConnContext *conn );
+
+	/**
+	 * @brief Merges log records of pvvx firmware received by finished connection to records of device
+	 * @param[in] conn Finished connection
+	 */
+	void mergePvvxLog( ConnContext *conn );
+
+	/**
+	 * @brief Copies newest history records of device
+	 * @param[in] device Device we are interested in
+	 * @param[out] records Newest records of device (oldest first)
+	 * @param[in] maxCount Max. number of records to copy
+	 * @return Returns number of copied records
+	 */
+	static size_t copyHistory( const LYWSD03MMCData *device, LYWSD03MMCHistory *records, size_t maxCount );
+
+	/**
+	 * @brief Runs service discovery and stores handles of characteristics to device of connection
+	 * @param[in] conn Connection to use
+	 * @return Returns 0 on success or <0 if error occured
+	 */
+	int  discoverHandles( ConnContext *conn );
+
+	/**
+	 * @brief Registers notifications for cached characteristic handle in local stack
+	 * @param[in] conn Connection to use
+	 * @param[in] handle Handle of characteristic
 	 * @param[in] doRegister true for register, false for unregister
 	 * @return Returns 0 on success or <0 if error occured
 	 */
-	int  registerNotification( bool doRegister = true );
+	int  registerNotification( ConnContext *conn, uint16_t handle, bool doRegister = true );
 
 	/**
 	 * @brief Sets BLE communication interval to 500ms (for battery save)
+	 * @param[in] conn Connection to use
 	 */
-	void setCommunicationInterval();
+	void setCommunicationInterval( ConnContext *conn );
 
 	/**
 	 * @brief Enables receiving of notifications from sensor
+	 * @param[in] conn Connection to use
+	 * @param[in] cccdHandle Handle of client characteristic configuration descriptor
 	 * @param[in] doEnable true for enable, false for disable
 	 * @return Returns 0 on success or <0 if error occured
 	 */
-	int  enableNotifications( bool doEnable = true );
+	int  enableNotifications( ConnContext *conn, uint16_t cccdHandle, bool doEnable = true );
+
+	/**
+	 * @brief Main function of connection worker task - waits for requests from process() and handles them
+	 * @param[in] param Pointer to connection context of task
+	 */
+	static void connTaskMain( void *param );
 
 	/**
-	 * @brief Connects to sensor with parameteris in @actDevice
+	 * @brief Connects to sensor of connection, waits for data and disconnects (called from worker task)
+	 * @param[in] conn Connection to use
 	 */
-	void connectSensor();
+	void connectSensor( ConnContext *conn );
+
+	/**
+	 * @brief Requests change of connection parameters by GAP connection parameter update
+	 * @param[in] conn Connection to use
+	 * @param[in] params Requested parameters
+	 */
+	void updateConnParams( ConnContext *conn, const LYWSD03MMCConnParams &params );
+
+	/**
+	 * @brief Waits in worker task until data are received, direct read fails or deadline expires
+	 * @param[in] conn Connection to wait for
+	 * @param[in] deadline Tick count when waiting ends
+	 */
+	void waitForData( ConnContext *conn, TickType_t deadline );
 
 	/**
 	 * @brief Disconnects form already connected sensor
+	 * @param[in] conn Connection to use
 	 */
-	void disconnectSensor();
+	void disconnectSensor( ConnContext *conn );
 
 	/**
-	 * @brief Sets data to sensor in @actDevice
+	 * @brief Sets data to sensor
+	 * @param[in] device Device with received data
 	 * @param[in] temp Actual temperature
 	 * @param[in] humidity Actual humidity
 	 * @param[in] voltage Actual voltage
 	 */
-	void setData( float temp, float humidity, float voltage );
-
-	/**
-	 * @brief Returns remote characteristics
-	 * @param[in] xcharUUID characteristics UUID
-	 * @return Returns remote characteristics or nullptr if error occured
-	 */
-	BLERemoteCharacteristic *getMainCharacteristic( BLEUUID &xcharUUID );
+	void setData( LYWSD03MMCData *device, float temp, float humidity, float voltage );
 };
 
 /* ************************************************************************** */
@@ -1,10 +1,7 @@
 #include "LYWSDCGQ.h"
 
 #include "Arduino.h"
-#include <BLEDevice.h>
-#include <BLEUtils.h>
-#include <BLEScan.h>
-#include <BLEAdvertisedDevice.h>
+#include "MiBeacon.h"
 #include "debug.h"
 
 /* ************************************************************************** */
@@ -18,42 +15,36 @@ LYWSDCGQ lywsdcgq;
  * @param[in] serviceDataUUID UUID of advertised service data
  * @param[in] serviceData Service data from ADV packet
  */
-void LYWSDCGQData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std::string &serviceData )
+void LYWSDCGQData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
 {
-	if( this->address->equals( *address ) == false )
-	{
-		return;
-	}
-
 	SERIAL_PRINTF("Found device: %s alias: %s\n", address->toString().c_str(), alias );
 
-	uint8_t tempData[32];
-	size_t  tempDataLen = 0;
-
-	size_t sdLength;
+	int offset;
 
 	advTimestamp = time( NULL );
 
-	if( serviceDataUUID != 0xFE95 )
+	stats.advCount++;
+	stats.addRssi( serviceData.rssi );
+
+	if( dupCache.isDuplicate( serviceDataUUID, serviceData.data, serviceData.length ) )
 	{
-		SERIAL_PRINTF("Received service data with not interested UUID %u\n", serviceDataUUID );
+		stats.advDuplicates++;
 		return;
 	}
 
-	if( (sdLength = serviceData.length()) > 11 )
+	if( serviceDataUUID != 0xFE95 )
 	{
-		serviceData.copy( (char*) tempData, sdLength - 11, 11 );
-		tempDataLen = sdLength - 11;
+		SERIAL_PRINTF("Received service data with not interested UUID %u\n", serviceDataUUID );
+		return;
 	}
 
-	if( !tempDataLen )
+	if( (offset = MiBeacon::objectsOffset( serviceData.data, serviceData.length )) < 0 )
 	{
 		SERIAL_PRINTF("We don't have enough service data\n");
 		return;
 	}
 
-	uint8_t serviceDataPerfix[4];
-	serviceData.copy( (char*) serviceDataPerfix, 4, 0 );
+	const uint8_t *serviceDataPerfix = serviceData.data;
 
 	if( serviceDataPerfix[0] != 0x50 || serviceDataPerfix[1] != 0x20 )
 	{
@@ -67,77 +58,11 @@ void LYWSDCGQData::onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std
 		return;
 	}
 
-	bool tempNew = false;
-	bool humidityNew = false;
-	bool batNew = false;
+	uint8_t updated = MiBeacon::decodeObjects( serviceData.data + offset, serviceData.length - offset, this, advTimestamp );
 
-	switch( tempData[0] )
-	{
-		case 0x04:
-		{
-			if( advTimestamp > nextTempNotify )
-			{
-				tempNew = true;
-				nextTempNotify = advTimestamp + cbkWaitTime;
-			}
-
-			values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
-			values.tempTimestamp = advTimestamp;
-		}
-		break;
-
-		case 0x06:
-		{
-			if( advTimestamp > nextHumidityNotify )
-			{
-				humidityNew = true;
-				nextHumidityNotify = advTimestamp + cbkWaitTime;
-			}
-
-			values.humidity = ((tempData[4] << 8) | tempData[3]) / 10.0;
-			values.humidityTimestamp = advTimestamp;
-		}
-		break;
-
-		case 0x0A:
-		{
-			if( advTimestamp > nextBatNotify )
-			{
-				batNew = true;
-				nextBatNotify = advTimestamp + cbkWaitTime;
-			}
-
-			values.bat = (float) tempData[3];
-			values.batTimestamp = advTimestamp;
-
-			// emulate voltage -> 3.1V = 100%, 2.1V = 0%
-			values.voltage = 2.1 + (values.bat / 100.0);
-
-		}
-		break;
-
-		case 0x0D:
-		{
-			if( advTimestamp > nextTempNotify )
-			{
-				tempNew = true;
-				nextTempNotify = advTimestamp + cbkWaitTime;
-			}
-
-			if( advTimestamp > nextHumidityNotify )
-			{
-				humidityNew = true;
-				nextHumidityNotify = advTimestamp + cbkWaitTime;
-			}
-
-			values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
-			values.humidity = ((tempData[6] << 8) | tempData[5]) / 10.0;
-
-			values.humidityTimestamp = advTimestamp;
-			values.tempTimestamp = advTimestamp;
-		}
-		break;
-	}
+	bool tempNew = updated & SENSOR_NEW_TEMP;
+	bool humidityNew = updated & SENSOR_NEW_HUMIDITY;
+	bool batNew = updated & SENSOR_NEW_BAT;
 
 	if( tempNew || humidityNew || batNew )
 	{
@@ -173,7 +98,7 @@ void LYWSDCGQ::deviceRegister( BLEAddress *address, const char *alias )
 	data->cbkWaitTime = cbkWaitTime;
 	data->regCbks = &regCbks;
 
-	bleAdvListener.cbkRegister( data );
+	bleAdvListener.cbkRegister( address, data );
 	regDevices.push_front( data );
 }
 
@@ -221,6 +146,50 @@ bool LYWSDCGQ::getData( BLEAddress &address, struct SensorValues *values )
 	return false;
 }
 
+/* ************************************************************************** */
+/**
+ * @brief Gets device statistics by alias
+ * @param[in] alias Alias of device we are interested in
+ * @param[out] stats Statistics for sensor with given alias
+ * @return Returns true if device with entered alias was found (registered)
+ */
+bool LYWSDCGQ::getStats( const char *alias, struct SensorStats *stats )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->alias && strcmp( (*it)->alias, alias ) == 0 )
+		{
+			*stats = (*it)->stats;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Gets device statistics by address
+ * @param[in] address Address of device we are interested in
+ * @param[out] stats Statistics for sensor with given address
+ * @return Returns true if device with entered address was found (registered)
+ */
+bool LYWSDCGQ::getStats( BLEAddress &address, struct SensorStats *stats )
+{
+	for( auto it = regDevices.cbegin(); it != regDevices.cend(); it++ )
+	{
+		if( (*it)->address->equals( address ) == true )
+		{
+			*stats = (*it)->stats;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /* ************************************************************************** */
 /**
  * @brief Registers new callback called on data refresh
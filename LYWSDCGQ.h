@@ -2,8 +2,6 @@
 
 #include "Arduino.h"
 #include "BleAdvListener.h"
-#include <BLEAddress.h>
-#include <BLEScan.h>
 #include "SensorCommon.h"
 #include <forward_list>
 
@@ -12,20 +10,16 @@
 /**
  * @brief Class with data from one LYWSDCGQ sensor
  */
-class LYWSDCGQData : public BleAdvListenerCbk
+class LYWSDCGQData : public BleAdvListenerCbk, private SensorState
 {
 private:
 	BLEAddress   *address;
 
 	const char  *alias;
 
-	struct       SensorValues values;
+	struct       SensorStats stats;
+	AdvDupCache   dupCache; // last frames received from device
 	time_t        advTimestamp = 0;
-	time_t        cbkWaitTime = 10;
-
-	time_t       nextTempNotify = 0;
-	time_t       nextHumidityNotify = 0;
-	time_t       nextBatNotify = 0;
 
 	std::forward_list<SensorDataChangeCbk *> *regCbks = nullptr; // list with registered callbacks
 
@@ -35,8 +29,6 @@ public:
 	{
 		this->address = address;
 		this->alias = alias;
-
-		memset( &values, 0, sizeof( struct SensorValues ) );
 	}
 
 	/**
@@ -45,7 +37,7 @@ public:
 	 * @param[in] serviceDataUUID UUID of advertised service data
 	 * @param[in] serviceData Service data from ADV packet
 	 */
-	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, std::string &serviceData );
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData );
 
 	friend class LYWSDCGQ;
 };
@@ -88,6 +80,22 @@ public:
 	 */
 	bool getData( BLEAddress &address, struct SensorValues *values );
 
+	/**
+	 * @brief Gets device statistics by alias
+	 * @param[in] alias Alias of device we are interested in
+	 * @param[out] stats Statistics for sensor with given alias
+	 * @return Returns true if device with entered alias was found (registered)
+	 */
+	bool getStats( const char *alias, struct SensorStats *stats );
+
+	/**
+	 * @brief Gets device statistics by MAC address
+	 * @param[in] address Address of device we are interested in
+	 * @param[out] stats Statistics for sensor with given address
+	 * @return Returns true if device with entered MAC was found (registered)
+	 */
+	bool getStats( BLEAddress &address, struct SensorStats *stats );
+
 	/**
 	 * @brief Registers new callback called on data refresh
 	 * @param[in] cbk Pointer to callback class
@@ -0,0 +1,102 @@
+#include "MiBeacon.h"
+
+/* ************************************************************************** */
+
+/**
+ * @brief Reads signed 16 bit little endian value of object
+ */
+static inline int16_t readInt16( const uint8_t *value )
+{
+	return (int16_t) (value[0] | (value[1] << 8));
+}
+
+/* ************************************************************************** */
+// decoders of supported object types - each one writes values directly to fields of sensor state
+
+static uint8_t decodeNone( const uint8_t *value, SensorState *state, time_t timestamp )
+{
+	return 0;
+}
+
+static uint8_t decodeTemp( const uint8_t *value, SensorState *state, time_t timestamp )
+{
+	return state->setTemp( readInt16( value ) / 10.0, timestamp );
+}
+
+static uint8_t decodeHumidity( const uint8_t *value, SensorState *state, time_t timestamp )
+{
+	return state->setHumidity( readInt16( value ) / 10.0, timestamp );
+}
+
+static uint8_t decodeBat( const uint8_t *value, SensorState *state, time_t timestamp )
+{
+	// emulate voltage -> 3.1V = 100%, 2.1V = 0%
+	return state->setBat( (float) value[0], 2.1 + (value[0] / 100.0), timestamp );
+}
+
+static uint8_t decodeTempHumidity( const uint8_t *value, SensorState *state, time_t timestamp )
+{
+	return state->setTemp( readInt16( value ) / 10.0, timestamp ) | state->setHumidity( readInt16( value + 2 ) / 10.0, timestamp );
+}
+
+/* ************************************************************************** */
+
+// supported objects have IDs 0x1000 - 0x100F, so table is indexed by low nibble of ID
+static const MiBeaconObjectDesc objectDescs[16] = {
+	/* 0x1000 */ { 0, decodeNone },
+	/* 0x1001 */ { 0, decodeNone },
+	/* 0x1002 */ { 0, decodeNone },
+	/* 0x1003 */ { 0, decodeNone },
+	/* 0x1004 */ { 2, decodeTemp },
+	/* 0x1005 */ { 0, decodeNone },
+	/* 0x1006 */ { 2, decodeHumidity },
+	/* 0x1007 */ { 0, decodeNone },
+	/* 0x1008 */ { 0, decodeNone },
+	/* 0x1009 */ { 0, decodeNone },
+	/* 0x100A */ { 1, decodeBat },
+	/* 0x100B */ { 0, decodeNone },
+	/* 0x100C */ { 0, decodeNone },
+	/* 0x100D */ { 4, decodeTempHumidity },
+	/* 0x100E */ { 0, decodeNone },
+	/* 0x100F */ { 0, decodeNone },
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Decodes all objects in one pass and stores their values directly to sensor state
+ * @param[in] data Objects (ID, length, value) one after another
+ * @param[in] length Length of data
+ * @param[in,out] state Sensor state where values are stored
+ * @param[in] timestamp Time when objects were received
+ * @return Returns mask of values whose callbacks should be called (SENSOR_NEW_*)
+ */
+uint8_t MiBeacon::decodeObjects( const uint8_t *data, size_t length, SensorState *state, time_t timestamp )
+{
+	uint8_t updated = 0;
+
+	// object: ID (2, LE), length (1), value
+	for( size_t offset = 0; offset + 3 <= length; )
+	{
+		const uint8_t *object = data + offset;
+		uint16_t       id = object[0] | (object[1] << 8);
+
+		offset += 3 + object[2];
+
+		if( offset > length )
+		{
+			break;
+		}
+
+		// unsupported objects in table have decoder which does nothing
+		const MiBeaconObjectDesc &desc = objectDescs[id & 0x0F];
+
+		if( (id & 0xFFF0) == 0x1000 && desc.length == object[2] )
+		{
+			updated |= desc.decode( object + 3, state, timestamp );
+		}
+	}
+
+	return updated;
+}
+
+/* ************************************************************************** */
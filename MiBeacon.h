@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Arduino.h"
+#include "SensorCommon.h"
+
+/* ************************************************************************** */
+
+#define MIBEACON_FC_ENCRYPTED    0x0008 // frame control - objects are encrypted
+#define MIBEACON_FC_MAC          0x0010 // frame control - MAC address is included
+#define MIBEACON_FC_CAPABILITY   0x0020 // frame control - capability byte is included
+#define MIBEACON_FC_OBJECT       0x0040 // frame control - object is included
+
+/* ************************************************************************** */
+/**
+ * @brief Decoder of one MiBeacon object type - stores object values directly to sensor state
+ * @param[in] value Object value (length is already checked)
+ * @param[in,out] state Sensor state where values are stored
+ * @param[in] timestamp Time when object was received
+ * @return Returns mask of values whose callbacks should be called (SENSOR_NEW_*)
+ */
+typedef uint8_t (*MiBeaconObjectDecoder)( const uint8_t *value, SensorState *state, time_t timestamp );
+
+/**
+ * @brief Description of one MiBeacon object type
+ */
+struct MiBeaconObjectDesc
+{
+	uint8_t                length;  // length of object value (not supported objects have 0 and decoder doing nothing)
+	MiBeaconObjectDecoder  decode;  // decoder of object value
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Decoder of MiBeacon frames (service data with UUID 0xFE95) shared by all Xiaomi sensors.
+ * Objects are dispatched by table of object descriptions, so new object type is one table entry with its decoder.
+ */
+class MiBeacon
+{
+public:
+	/**
+	 * @brief Returns offset of first object in MiBeacon frame
+	 * @param[in] frame MiBeacon frame (service data)
+	 * @param[in] length Length of frame
+	 * @return Returns offset of objects or -1 if frame has no objects
+	 */
+	static int objectsOffset( const uint8_t *frame, size_t length )
+	{
+		// frame control (2), product ID (2), frame counter (1)
+		if( length < 5 )
+		{
+			return -1;
+		}
+
+		uint16_t frameControl = frame[0] | (frame[1] << 8);
+		size_t   offset = 5;
+
+		if( (frameControl & MIBEACON_FC_OBJECT) == 0 )
+		{
+			return -1;
+		}
+
+		if( frameControl & MIBEACON_FC_MAC )
+		{
+			offset += 6;
+		}
+
+		if( frameControl & MIBEACON_FC_CAPABILITY )
+		{
+			offset += 1;
+		}
+
+		return offset < length ? (int) offset : -1;
+	}
+
+	/**
+	 * @brief Decodes all objects in one pass and stores their values directly to sensor state
+	 * @param[in] data Objects (ID, length, value) one after another
+	 * @param[in] length Length of data
+	 * @param[in,out] state Sensor state where values are stored
+	 * @param[in] timestamp Time when objects were received
+	 * @return Returns mask of values whose callbacks should be called (SENSOR_NEW_*)
+	 */
+	static uint8_t decodeObjects( const uint8_t *data, size_t length, SensorState *state, time_t timestamp );
+};
+
+/* ************************************************************************** */
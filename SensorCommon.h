@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Arduino.h"
-#include <BLEDevice.h>
+#include "BleTransport.h"
 
 /* ************************************************************************** */
 /**
@@ -40,3 +40,181 @@ struct SensorValues
 };
 
 /* ************************************************************************** */
+
+// values which were updated and their callbacks should be called (returned by decoders as bit mask)
+#define SENSOR_NEW_TEMP      0x01
+#define SENSOR_NEW_HUMIDITY  0x02
+#define SENSOR_NEW_BAT       0x04
+
+/**
+ * @brief Last values of one sensor with time of next allowed callback of each value - common for all sensor types.
+ * Decoders store values directly by setters, which also decide if callbacks should be called.
+ */
+struct SensorState
+{
+	struct SensorValues values;
+
+	time_t       cbkWaitTime = 10;  // minimum time in seconds between two callback calls for the same value
+	time_t       nextTempNotify = 0;
+	time_t       nextHumidityNotify = 0;
+	time_t       nextBatNotify = 0;
+
+	/**
+	 * @brief Stores temperature
+	 * @param[in] temp Decoded temperature
+	 * @param[in] timestamp Time when value was received
+	 * @return Returns SENSOR_NEW_TEMP when temp callback should be called, otherwise 0
+	 */
+	uint8_t setTemp( float temp, time_t timestamp )
+	{
+		values.temp = temp;
+		values.tempTimestamp = timestamp;
+
+		if( timestamp > nextTempNotify )
+		{
+			nextTempNotify = timestamp + cbkWaitTime;
+			return SENSOR_NEW_TEMP;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * @brief Stores humidity
+	 * @param[in] humidity Decoded humidity
+	 * @param[in] timestamp Time when value was received
+	 * @return Returns SENSOR_NEW_HUMIDITY when humidity callback should be called, otherwise 0
+	 */
+	uint8_t setHumidity( float humidity, time_t timestamp )
+	{
+		values.humidity = humidity;
+		values.humidityTimestamp = timestamp;
+
+		if( timestamp > nextHumidityNotify )
+		{
+			nextHumidityNotify = timestamp + cbkWaitTime;
+			return SENSOR_NEW_HUMIDITY;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * @brief Stores battery level and voltage
+	 * @param[in] bat Decoded battery level in %
+	 * @param[in] voltage Decoded or emulated battery voltage
+	 * @param[in] timestamp Time when values were received
+	 * @return Returns SENSOR_NEW_BAT when battery callback should be called, otherwise 0
+	 */
+	uint8_t setBat( float bat, float voltage, time_t timestamp )
+	{
+		values.bat = bat;
+		values.voltage = voltage;
+		values.batTimestamp = timestamp;
+
+		if( timestamp > nextBatNotify )
+		{
+			nextBatNotify = timestamp + cbkWaitTime;
+			return SENSOR_NEW_BAT;
+		}
+
+		return 0;
+	}
+};
+
+/* ************************************************************************** */
+
+#define RSSI_EWMA_WEIGHT  0.125 // weight of new packet in smoothed RSSI
+
+/**
+ * @brief Statistics of one sensor
+ */
+struct SensorStats
+{
+	uint32_t     advCount = 0;      // number of received ADV service data
+	uint32_t     advDuplicates = 0; // number of ADV service data dropped as repeated frame
+	uint32_t     refreshCount = 0;  // number of started active refreshes
+	uint32_t     refreshSkipped = 0; // number of planned refreshes skipped due to fresh passive data
+	time_t       refreshLateLast = 0; // delay of last refresh against planned time (s)
+	time_t       refreshLateMax = 0;  // max. delay of refresh against planned time (s)
+	uint32_t     connDataTimeLast = 0; // time from connection request to received data of last refresh (ms)
+	uint32_t     readOk = 0;        // number of refreshes with data read directly
+	uint32_t     readFailed = 0;    // number of failed direct reads (data requested by notification)
+	uint32_t     notifyOk = 0;      // number of refreshes with data received by notification
+	uint32_t     readTimeTotal = 0;   // sum of connDataTimeLast of refreshes with direct read (ms)
+	uint32_t     notifyTimeTotal = 0; // sum of connDataTimeLast of refreshes with notification (ms)
+	uint32_t     connFailed = 0;    // number of connections without data
+	uint32_t     connFailStreak = 0; // number of consecutive connections without data
+	uint32_t     breakerTrips = 0;  // number of times when device was switched to passive only
+	bool         breakerOpen = false; // device is passive only due to failing connections
+	time_t       retryAt = 0;       // time of next connection attempt after failure
+	uint32_t     linkCount = 0;     // number of established connections
+	uint32_t     linkTimeLast = 0;  // duration of last connection from connect to disconnect (ms)
+	uint32_t     linkTimeTotal = 0; // sum of durations of all connections (ms)
+	time_t       refreshInterval = 0; // actual interval of active refresh (changed by adaptive refresh)
+	float        rssi = 0.0;        // exponentially smoothed RSSI of received ADV packets in dBm (0 = unknown)
+	uint32_t     histRecords = 0;   // history records received by backfill
+
+	/**
+	 * @brief Adds RSSI of received ADV packet to smoothed value
+	 * @param[in] packetRssi RSSI of packet in dBm (positive value means unknown RSSI and is ignored)
+	 */
+	void addRssi( int8_t packetRssi )
+	{
+		if( packetRssi >= 0 )
+		{
+			return;
+		}
+
+		rssi = (rssi == 0.0) ? packetRssi : rssi + (packetRssi - rssi) * RSSI_EWMA_WEIGHT;
+	}
+};
+
+/* ************************************************************************** */
+
+#define ADV_DUP_CACHE_SIZE  4 // number of last frames remembered per device
+
+/**
+ * @brief Small cache of last frames received from one device. Sensors repeat the same frame
+ * (with the same frame counter) many times, so repeated frames can be dropped before decoding.
+ */
+class AdvDupCache
+{
+public:
+	/**
+	 * @brief Checks if frame was already received and remembers it
+	 * @param[in] serviceDataUUID UUID of advertised service data
+	 * @param[in] data Service data from ADV packet
+	 * @param[in] length Length of service data
+	 * @return Returns true if the same frame was received recently
+	 */
+	bool isDuplicate( uint16_t serviceDataUUID, const uint8_t *data, size_t length )
+	{
+		// FNV-1a of whole frame - it contains frame counter, so new measurement gives new hash
+		uint32_t hash = (2166136261u ^ serviceDataUUID) * 16777619u;
+
+		for( size_t i = 0; i < length; i++ )
+		{
+			hash = (hash ^ data[i]) * 16777619u;
+		}
+
+		for( int i = 0; i < ADV_DUP_CACHE_SIZE; i++ )
+		{
+			if( hashes[i] == hash )
+			{
+				return true;
+			}
+		}
+
+		hashes[next] = hash;
+		next = (next + 1) % ADV_DUP_CACHE_SIZE;
+
+		return false;
+	}
+
+private:
+	uint32_t hashes[ADV_DUP_CACHE_SIZE] = { 0 };
+	uint8_t  next = 0;
+};
+
+/* ************************************************************************** */
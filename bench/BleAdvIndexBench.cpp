@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+#include "BleAdvIndex.h"
+#include <string.h>
+#include <vector>
+
+/* ************************************************************************** */
+/**
+ * @brief Device callback as it was called before address index - every device checks address itself
+ */
+class DeviceCbk
+{
+public:
+	uint8_t  mac[BLE_ADDRESS_LEN];
+	uint32_t count = 0;
+
+	virtual ~DeviceCbk() {}
+
+	virtual void onAdvData( const uint8_t *address )
+	{
+		if( memcmp( mac, address, BLE_ADDRESS_LEN ) != 0 )
+		{
+			return;
+		}
+
+		count++;
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Given number of registered devices, both in address index and in list for fan-out
+ */
+struct DispatchFixture
+{
+	std::vector<DeviceCbk> devices;
+	BleAdvIndex            index;
+
+	DispatchFixture( int count ) : devices( count )
+	{
+		for( int i = 0; i < count; i++ )
+		{
+			uint8_t mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, (uint8_t) (i >> 16), (uint8_t) (i >> 8), (uint8_t) i };
+
+			memcpy( devices[i].mac, mac, BLE_ADDRESS_LEN );
+			// index only stores callback pointer, so it can point to device of this benchmark
+			index.insert( mac, reinterpret_cast<BleAdvListenerCbk *>( &devices[i] ) );
+		}
+	}
+
+	/**
+	 * @brief Dispatches ADV packet through address index
+	 * @param[in] mac Address of advertising device
+	 */
+	void dispatchIndex( const uint8_t *mac )
+	{
+		BleAdvListenerCbk *cbk = index.find( mac );
+
+		if( cbk != nullptr )
+		{
+			reinterpret_cast<DeviceCbk *>( cbk )->onAdvData( mac );
+		}
+	}
+
+	/**
+	 * @brief Dispatches ADV packet to all registered devices
+	 * @param[in] mac Address of advertising device
+	 */
+	void dispatchFanOut( const uint8_t *mac )
+	{
+		for( auto it = devices.begin(); it != devices.end(); it++ )
+		{
+			it->onAdvData( mac );
+		}
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief ADV packet from registered device dispatched through address index
+ */
+static void BM_IndexRegistered( benchmark::State &state )
+{
+	DispatchFixture fixture( state.range( 0 ) );
+	size_t          i = 0;
+
+	for( auto _ : state )
+	{
+		fixture.dispatchIndex( fixture.devices[i].mac );
+		i = (i + 1 == fixture.devices.size()) ? 0 : i + 1;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+	benchmark::DoNotOptimize( fixture.devices[0].count );
+}
+
+BENCHMARK( BM_IndexRegistered )->Arg( 10 )->Arg( 100 )->Arg( 1000 );
+
+/* ************************************************************************** */
+/**
+ * @brief ADV packet from not registered device dispatched through address index
+ */
+static void BM_IndexUnregistered( benchmark::State &state )
+{
+	DispatchFixture fixture( state.range( 0 ) );
+	uint8_t         mac[BLE_ADDRESS_LEN] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+
+	for( auto _ : state )
+	{
+		mac[5]++;
+		fixture.dispatchIndex( mac );
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+	benchmark::DoNotOptimize( fixture.devices[0].count );
+}
+
+BENCHMARK( BM_IndexUnregistered )->Arg( 10 )->Arg( 100 )->Arg( 1000 );
+
+/* ************************************************************************** */
+/**
+ * @brief ADV packet from registered device dispatched to every device (previous implementation)
+ */
+static void BM_FanOutRegistered( benchmark::State &state )
+{
+	DispatchFixture fixture( state.range( 0 ) );
+	size_t          i = 0;
+
+	for( auto _ : state )
+	{
+		fixture.dispatchFanOut( fixture.devices[i].mac );
+		i = (i + 1 == fixture.devices.size()) ? 0 : i + 1;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+	benchmark::DoNotOptimize( fixture.devices[0].count );
+}
+
+BENCHMARK( BM_FanOutRegistered )->Arg( 10 )->Arg( 100 )->Arg( 1000 );
+
+/* ************************************************************************** */
@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+#include "BleAdvListener.h"
+#include "BleTransportFake.h"
+#include <vector>
+
+/* ************************************************************************** */
+/**
+ * @brief Callback which only counts received service data
+ */
+class CountingCbk : public BleAdvListenerCbk
+{
+public:
+	uint32_t count = 0;
+
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
+	{
+		count++;
+	}
+};
+
+// flags and one service data AD structure of atc1441 firmware
+static const uint8_t payload[] = {
+	0x02, 0x01, 0x06,
+	0x10, BLE_AD_TYPE_SERVICE_DATA, 0x1A, 0x18, 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x00, 0x00, 0xD2, 0x28, 0x50, 0x0B, 0xB8, 0x01,
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Listener with given number of registered devices
+ */
+struct DispatchFixture
+{
+	BleAdvListener            listener;
+	BleScannerFake            scanner;
+	CountingCbk               cbk;
+	std::vector<BLEAddress *> addresses;
+
+	DispatchFixture( int devices )
+	{
+		listener.init( &scanner );
+
+		for( int i = 0; i < devices; i++ )
+		{
+			uint8_t mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, (uint8_t) (i >> 16), (uint8_t) (i >> 8), (uint8_t) i };
+
+			addresses.push_back( new BLEAddress( mac ) );
+			listener.cbkRegister( addresses.back(), &cbk );
+		}
+	}
+
+	~DispatchFixture()
+	{
+		for( auto it = addresses.begin(); it != addresses.end(); it++ )
+		{
+			delete *it;
+		}
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief ADV packet from registered device - address lookup, copy to ring and callback from process()
+ */
+static void BM_DispatchRegistered( benchmark::State &state )
+{
+	DispatchFixture fixture( state.range( 0 ) );
+	size_t          i = 0;
+
+	for( auto _ : state )
+	{
+		const uint8_t *mac = *fixture.addresses[i]->getNative();
+
+		fixture.scanner.deliver( mac, payload, sizeof( payload ) );
+		fixture.listener.process();
+
+		i = (i + 1 == fixture.addresses.size()) ? 0 : i + 1;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+	benchmark::DoNotOptimize( fixture.cbk.count );
+}
+
+BENCHMARK( BM_DispatchRegistered )->Arg( 10 )->Arg( 100 )->Arg( 1000 );
+
+/* ************************************************************************** */
+/**
+ * @brief ADV packet from not registered device - it should be dropped by address lookup only
+ */
+static void BM_DispatchUnregistered( benchmark::State &state )
+{
+	DispatchFixture fixture( state.range( 0 ) );
+	uint8_t         mac[BLE_ADDRESS_LEN] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+
+	for( auto _ : state )
+	{
+		mac[5]++;
+
+		fixture.scanner.deliver( mac, payload, sizeof( payload ) );
+		fixture.listener.process();
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+	benchmark::DoNotOptimize( fixture.cbk.count );
+}
+
+BENCHMARK( BM_DispatchUnregistered )->Arg( 10 )->Arg( 100 )->Arg( 1000 );
+
+/* ************************************************************************** */
@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+#include "mbedtls/ccm.h"
+#include <stdint.h>
+#include <string.h>
+
+/* ************************************************************************** */
+
+static const uint8_t key[16] = { 0x23, 0x1D, 0x39, 0xC1, 0xD7, 0xCC, 0x1A, 0xB1, 0xAE, 0xE2, 0x24, 0xCD, 0x09, 0x6D, 0xB9, 0x32 };
+static const uint8_t mac[6] = { 0xA4, 0xC1, 0x38, 0x40, 0x00, 0x01 };
+
+static const unsigned char authData = 0x11;
+
+/**
+ * @brief Builds encrypted MiBeacon of stock LYWSD03MMC firmware with battery object
+ * @param[out] frame Service data (22 bytes)
+ */
+static void buildFrame( uint8_t frame[22] )
+{
+	const uint8_t       object[4] = { 0x0A, 0x10, 0x01, 0x5A };
+	uint8_t             iv[12];
+	mbedtls_ccm_context ccm;
+
+	// frame control, product id, frame counter, MAC (LE), encrypted object, extended counter, MIC
+	frame[0] = 0x58;
+	frame[1] = 0x58;
+	frame[2] = 0x5B;
+	frame[3] = 0x05;
+	frame[4] = 0x01;
+
+	for( int i = 0; i < 6; i++ )
+	{
+		frame[5 + i] = mac[5 - i];
+	}
+
+	frame[15] = 0;
+	frame[16] = 0;
+	frame[17] = 0;
+
+	memcpy( iv, frame + 5, 6 );
+	memcpy( iv + 6, frame + 2, 3 );
+	memcpy( iv + 9, frame + 15, 3 );
+
+	mbedtls_ccm_init( &ccm );
+	mbedtls_ccm_setkey( &ccm, MBEDTLS_CIPHER_ID_AES, key, 16 * 8 );
+	mbedtls_ccm_encrypt_and_tag( &ccm, sizeof( object ), iv, 12, &authData, 1, object, frame + 11, frame + 18, 4 );
+	mbedtls_ccm_free( &ccm );
+}
+
+/**
+ * @brief Builds nonce of encrypted frame the same way as LYWSD03MMCData::decryptServiceData()
+ * @param[in] frame Service data
+ * @param[out] iv Nonce
+ */
+static void buildIv( const uint8_t *frame, uint8_t iv[16] )
+{
+	memcpy( iv, frame + 5, 6 );      // MAC address reversed
+	memcpy( iv + 6, frame + 2, 3 );  // sensor type (2) + packet id (1)
+	memcpy( iv + 9, frame + 15, 3 ); // payload counter
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Decryption with CCM context keyed once per device (as LYWSD03MMCData does it now)
+ */
+static void BM_CcmKeyOnce( benchmark::State &state )
+{
+	mbedtls_ccm_context ccm;
+	uint8_t             frame[22];
+	uint8_t             decrypted[16];
+	uint8_t             iv[16];
+
+	buildFrame( frame );
+
+	mbedtls_ccm_init( &ccm );
+	mbedtls_ccm_setkey( &ccm, MBEDTLS_CIPHER_ID_AES, key, 16 * 8 );
+
+	for( auto _ : state )
+	{
+		buildIv( frame, iv );
+
+		if( mbedtls_ccm_auth_decrypt( &ccm, 4, iv, 12, &authData, 1, frame + 11, decrypted, frame + 18, 4 ) != 0 )
+		{
+			state.SkipWithError( "decryption failed" );
+			break;
+		}
+
+		benchmark::DoNotOptimize( decrypted );
+	}
+
+	mbedtls_ccm_free( &ccm );
+
+	state.SetItemsProcessed( state.iterations() );
+}
+
+BENCHMARK( BM_CcmKeyOnce );
+
+/* ************************************************************************** */
+/**
+ * @brief Decryption with key expanded for every frame (as it was done before)
+ */
+static void BM_CcmKeyPerFrame( benchmark::State &state )
+{
+	uint8_t frame[22];
+	uint8_t decrypted[16];
+	uint8_t iv[16];
+
+	buildFrame( frame );
+
+	for( auto _ : state )
+	{
+		buildIv( frame, iv );
+
+		mbedtls_ccm_context ctx;
+		mbedtls_ccm_init( &ctx );
+
+		if( mbedtls_ccm_setkey( &ctx, MBEDTLS_CIPHER_ID_AES, key, 16 * 8 ) != 0
+				|| mbedtls_ccm_auth_decrypt( &ctx, 4, iv, 12, &authData, 1, frame + 11, decrypted, frame + 18, 4 ) != 0 )
+		{
+			mbedtls_ccm_free( &ctx );
+			state.SkipWithError( "decryption failed" );
+			break;
+		}
+
+		mbedtls_ccm_free( &ctx );
+
+		benchmark::DoNotOptimize( decrypted );
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+}
+
+BENCHMARK( BM_CcmKeyPerFrame );
+
+/* ************************************************************************** */
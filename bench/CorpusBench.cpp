@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+#include "FuzzTargets.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+ * Fuzz targets run over their seed corpus (fuzz/corpus/<target>) - decoding cost of realistic frames
+ * of every decoder entry point. One iteration decodes one input.
+ */
+
+/* ************************************************************************** */
+/**
+ * @brief Reads all files of corpus directory
+ * @param[in] name Name of fuzz target
+ * @return Returns content of files
+ */
+static std::vector<std::vector<uint8_t>> loadCorpus( const char *name )
+{
+	std::vector<std::vector<uint8_t>> inputs;
+	std::string                       dirPath = std::string( FUZZ_CORPUS_DIR ) + "/" + name;
+	DIR                              *dir = opendir( dirPath.c_str() );
+	struct dirent                    *entry;
+
+	while( dir != nullptr && (entry = readdir( dir )) != nullptr )
+	{
+		FILE *file;
+
+		if( entry->d_name[0] == '.' || (file = fopen( (dirPath + "/" + entry->d_name).c_str(), "rb" )) == nullptr )
+		{
+			continue;
+		}
+
+		std::vector<uint8_t> data;
+		int                  c;
+
+		while( (c = fgetc( file )) != EOF )
+		{
+			data.push_back( (uint8_t) c );
+		}
+
+		fclose( file );
+		inputs.push_back( data );
+	}
+
+	if( dir != nullptr )
+	{
+		closedir( dir );
+	}
+
+	return inputs;
+}
+
+/* ************************************************************************** */
+
+static void BM_Corpus( benchmark::State &state, const FuzzTarget *target )
+{
+	std::vector<std::vector<uint8_t>> inputs = loadCorpus( target->name );
+	size_t                            i = 0;
+
+	if( inputs.empty() )
+	{
+		state.SkipWithError( "empty corpus" );
+		return;
+	}
+
+	for( auto _ : state )
+	{
+		target->run( inputs[i].data(), inputs[i].size() );
+
+		i = (i + 1 == inputs.size()) ? 0 : i + 1;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+}
+
+/**
+ * @brief Registers one benchmark for every fuzz target
+ */
+static int registerCorpusBenchmarks()
+{
+	for( size_t i = 0; i < fuzzTargetCount; i++ )
+	{
+		benchmark::RegisterBenchmark( (std::string( "BM_Corpus/" ) + fuzzTargets[i].name).c_str(), BM_Corpus, &fuzzTargets[i] );
+	}
+
+	return 0;
+}
+
+static int corpusBenchmarks = registerCorpusBenchmarks();
+
+/* ************************************************************************** */
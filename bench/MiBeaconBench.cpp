@@ -0,0 +1,157 @@
+#include <benchmark/benchmark.h>
+#include "MiBeacon.h"
+
+/* ************************************************************************** */
+
+// MiBeacon frames of LYWSDCGQ - sensor sends temperature, humidity, battery and combined object in turns
+static const uint8_t frames[4][18] = {
+	{ 0x50, 0x20, 0xAA, 0x01, 0x01, 0x01, 0x00, 0x50, 0x38, 0xC1, 0xA4, 0x04, 0x10, 0x02, 0xD7, 0x00 },
+	{ 0x50, 0x20, 0xAA, 0x01, 0x02, 0x01, 0x00, 0x50, 0x38, 0xC1, 0xA4, 0x06, 0x10, 0x02, 0xC2, 0x01 },
+	{ 0x50, 0x20, 0xAA, 0x01, 0x03, 0x01, 0x00, 0x50, 0x38, 0xC1, 0xA4, 0x0A, 0x10, 0x01, 0x5A },
+	{ 0x50, 0x20, 0xAA, 0x01, 0x04, 0x01, 0x00, 0x50, 0x38, 0xC1, 0xA4, 0x0D, 0x10, 0x04, 0xD7, 0x00, 0xC2, 0x01 },
+};
+
+static const size_t frameLengths[4] = { 16, 16, 15, 18 };
+
+/* ************************************************************************** */
+/**
+ * @brief Decoding by object table shared by all sensors (current code)
+ */
+static void BM_MiBeaconTable( benchmark::State &state )
+{
+	SensorState sensor;
+	time_t      timestamp = 1000;
+	size_t      i = 0;
+
+	for( auto _ : state )
+	{
+		const uint8_t *frame = frames[i];
+		size_t         length = frameLengths[i];
+		bool           tempNew = false;
+		bool           humidityNew = false;
+		bool           batNew = false;
+		int            offset = MiBeacon::objectsOffset( frame, length );
+
+		if( offset >= 0 )
+		{
+			uint8_t updated = MiBeacon::decodeObjects( frame + offset, length - offset, &sensor, timestamp );
+
+			tempNew = updated & SENSOR_NEW_TEMP;
+			humidityNew = updated & SENSOR_NEW_HUMIDITY;
+			batNew = updated & SENSOR_NEW_BAT;
+		}
+
+		benchmark::DoNotOptimize( tempNew );
+		benchmark::DoNotOptimize( sensor.values );
+
+		i = (i + 1) & 0x03;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+}
+
+BENCHMARK( BM_MiBeaconTable );
+
+/* ************************************************************************** */
+/**
+ * @brief Decoding by switch of object types copied from each sensor class (code before object table)
+ */
+static void BM_MiBeaconSwitch( benchmark::State &state )
+{
+	SensorState sensor;
+	time_t      advTimestamp = 1000;
+	size_t      i = 0;
+
+	for( auto _ : state )
+	{
+		const uint8_t *frame = frames[i];
+		size_t         sdLength = frameLengths[i];
+		bool           tempNew = false;
+		bool           humidityNew = false;
+		bool           batNew = false;
+		uint8_t        tempData[32];
+
+		memcpy( tempData, frame + 11, sdLength - 11 );
+
+		if( frame[0] == 0x50 && frame[1] == 0x20 && frame[2] == 0xAA && frame[3] == 0x01 )
+		{
+			switch( tempData[0] )
+			{
+				case 0x04:
+				{
+					if( advTimestamp > sensor.nextTempNotify )
+					{
+						tempNew = true;
+						sensor.nextTempNotify = advTimestamp + sensor.cbkWaitTime;
+					}
+
+					sensor.values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
+					sensor.values.tempTimestamp = advTimestamp;
+				}
+				break;
+
+				case 0x06:
+				{
+					if( advTimestamp > sensor.nextHumidityNotify )
+					{
+						humidityNew = true;
+						sensor.nextHumidityNotify = advTimestamp + sensor.cbkWaitTime;
+					}
+
+					sensor.values.humidity = ((tempData[4] << 8) | tempData[3]) / 10.0;
+					sensor.values.humidityTimestamp = advTimestamp;
+				}
+				break;
+
+				case 0x0A:
+				{
+					if( advTimestamp > sensor.nextBatNotify )
+					{
+						batNew = true;
+						sensor.nextBatNotify = advTimestamp + sensor.cbkWaitTime;
+					}
+
+					sensor.values.bat = (float) tempData[3];
+					sensor.values.batTimestamp = advTimestamp;
+
+					// emulate voltage -> 3.1V = 100%, 2.1V = 0%
+					sensor.values.voltage = 2.1 + (sensor.values.bat / 100.0);
+				}
+				break;
+
+				case 0x0D:
+				{
+					if( advTimestamp > sensor.nextTempNotify )
+					{
+						tempNew = true;
+						sensor.nextTempNotify = advTimestamp + sensor.cbkWaitTime;
+					}
+
+					if( advTimestamp > sensor.nextHumidityNotify )
+					{
+						humidityNew = true;
+						sensor.nextHumidityNotify = advTimestamp + sensor.cbkWaitTime;
+					}
+
+					sensor.values.temp = ((tempData[4] << 8) | tempData[3]) / 10.0;
+					sensor.values.humidity = ((tempData[6] << 8) | tempData[5]) / 10.0;
+
+					sensor.values.humidityTimestamp = advTimestamp;
+					sensor.values.tempTimestamp = advTimestamp;
+				}
+				break;
+			}
+		}
+
+		benchmark::DoNotOptimize( tempNew );
+		benchmark::DoNotOptimize( sensor.values );
+
+		i = (i + 1) & 0x03;
+	}
+
+	state.SetItemsProcessed( state.iterations() );
+}
+
+BENCHMARK( BM_MiBeaconSwitch );
+
+/* ************************************************************************** */
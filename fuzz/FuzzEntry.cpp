@@ -0,0 +1,12 @@
+#include "FuzzTargets.h"
+
+/*
+ * Entry point of one fuzzer - FUZZ_TARGET is set to function of target by build
+ */
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size )
+{
+	FUZZ_TARGET( data, size );
+
+	return 0;
+}
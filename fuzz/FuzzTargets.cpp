@@ -0,0 +1,183 @@
+#include "FuzzTargets.h"
+#include "AdvParsers.h"
+#include "BleAdvListener.h"
+#include "BleTransportFake.h"
+#include "LYWSD03MMC.h"
+#include "LYWSDCGQ.h"
+#include "MiBeacon.h"
+
+/* ************************************************************************** */
+
+const FuzzTarget fuzzTargets[] = {
+	{ "lywsd03mmc_adv", fuzzLYWSD03MMCAdv },
+	{ "lywsdcgq_adv",   fuzzLYWSDCGQAdv },
+	{ "mibeacon",       fuzzMiBeacon },
+	{ "adv_parser",     fuzzAdvParser },
+	{ "notify",         fuzzNotify },
+	{ "adv_payload",    fuzzAdvPayload },
+};
+
+const size_t fuzzTargetCount = sizeof( fuzzTargets ) / sizeof( fuzzTargets[0] );
+
+// bind key used for encrypted frames in corpus
+static const uint8_t fuzzKey[16] = { 0x23, 0x1D, 0x39, 0xC1, 0xD7, 0xCC, 0x1A, 0xB1, 0xAE, 0xE2, 0x24, 0xCD, 0x09, 0x6D, 0xB9, 0x32 };
+
+static uint8_t lywsd03mmcMac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0xF0, 0x00, 0x01 };
+static uint8_t lywsdcgqMac[BLE_ADDRESS_LEN] = { 0x4C, 0x65, 0xA8, 0xF0, 0x00, 0x02 };
+
+/* ************************************************************************** */
+/**
+ * @brief Injects service data as one AD structure to global listener in inject mode
+ * @param[in] mac Address of registered device
+ * @param[in] data UUID (LE) followed by service data
+ * @param[in] size Length of data
+ */
+static void injectServiceData( const uint8_t *mac, const uint8_t *data, size_t size )
+{
+	uint8_t payload[2 + 255];
+
+	if( size < 2 || size > 254 )
+	{
+		return;
+	}
+
+	payload[0] = 1 + size;
+	payload[1] = BLE_AD_TYPE_SERVICE_DATA;
+	memcpy( payload + 2, data, size );
+
+	bleAdvListener.injectAdv( mac, payload, 2 + size );
+	bleAdvListener.process();
+}
+
+/* ************************************************************************** */
+
+void fuzzLYWSD03MMCAdv( const uint8_t *data, size_t size )
+{
+	static LYWSD03MMC *sensor = nullptr;
+
+	if( sensor == nullptr )
+	{
+		// sensor class isn't initialised - no connections, only ADV packets are decoded
+		sensor = new LYWSD03MMC();
+		sensor->deviceRegister( new BLEAddress( lywsd03mmcMac ), "fuzz", fuzzKey );
+		bleAdvListener.initInject();
+	}
+
+	injectServiceData( lywsd03mmcMac, data, size );
+}
+
+/* ************************************************************************** */
+
+void fuzzLYWSDCGQAdv( const uint8_t *data, size_t size )
+{
+	static LYWSDCGQ *sensor = nullptr;
+
+	if( sensor == nullptr )
+	{
+		sensor = new LYWSDCGQ();
+		sensor->init();
+		sensor->deviceRegister( new BLEAddress( lywsdcgqMac ), "fuzz" );
+		bleAdvListener.initInject();
+	}
+
+	injectServiceData( lywsdcgqMac, data, size );
+}
+
+/* ************************************************************************** */
+
+void fuzzMiBeacon( const uint8_t *data, size_t size )
+{
+	SensorState state;
+	int         offset = MiBeacon::objectsOffset( data, size );
+
+	if( offset >= 0 )
+	{
+		MiBeacon::decodeObjects( data + offset, size - offset, &state, 1 );
+	}
+}
+
+/* ************************************************************************** */
+
+void fuzzAdvParser( const uint8_t *data, size_t size )
+{
+	SensorState state;
+
+	if( size < 2 )
+	{
+		return;
+	}
+
+	uint16_t       uuid = data[0] | (data[1] << 8);
+	const uint8_t *serviceData = data + 2;
+
+	switch( advFormat( uuid, size - 2 ) )
+	{
+		case ADV_FMT_ATC1441 :
+		{
+			AdvParser<ADV_FMT_ATC1441>::parse( serviceData, &state, 1 );
+		}
+		break;
+
+		case ADV_FMT_PVVX :
+		{
+			AdvParser<ADV_FMT_PVVX>::parse( serviceData, &state, 1 );
+		}
+		break;
+
+		default :
+		break;
+	}
+}
+
+/* ************************************************************************** */
+
+void fuzzNotify( const uint8_t *data, size_t size )
+{
+	float             temp;
+	float             humidity;
+	float             voltage;
+	LYWSD03MMCHistory record;
+
+	LYWSD03MMC::parseData( data, size, &temp, &humidity, &voltage );
+	LYWSD03MMC::parseHistoryRecord( data, size, &record );
+	LYWSD03MMC::parsePvvxLogRecord( data, size, &record );
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Callback which reads all bytes of borrowed service data
+ */
+class FuzzCbk : public BleAdvListenerCbk
+{
+public:
+	uint32_t sum = 0;
+
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
+	{
+		for( size_t i = 0; i < serviceData.length; i++ )
+		{
+			sum += serviceData.data[i];
+		}
+	}
+};
+
+void fuzzAdvPayload( const uint8_t *data, size_t size )
+{
+	static BleAdvListener *listener = nullptr;
+	static BleScannerFake *scanner = nullptr;
+	static uint8_t         mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0xF0, 0x00, 0x03 };
+	static BLEAddress      address( mac );
+
+	if( listener == nullptr )
+	{
+		listener = new BleAdvListener();
+		scanner = new BleScannerFake();
+		listener->init( scanner );
+		listener->cbkRegister( &address, new FuzzCbk() );
+	}
+
+	scanner->deliver( mac, data, size );
+	listener->process();
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Fuzz targets - one for every decoder entry point. Every target is built as own fuzzer (fuzz_<name>)
+ * with seed corpus in fuzz/corpus/<name>. Benchmarks run the same targets over the same corpus.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ************************************************************************** */
+/**
+ * @brief Fuzz target
+ */
+struct FuzzTarget
+{
+	const char   *name;  // name of target - fuzzer executable and corpus directory
+	void         (*run)( const uint8_t *data, size_t size );
+};
+
+/**
+ * @brief Service data (UUID LE, data) of registered LYWSD03MMC with bind key - LYWSD03MMCData::onAdvData()
+ */
+void fuzzLYWSD03MMCAdv( const uint8_t *data, size_t size );
+
+/**
+ * @brief Service data (UUID LE, data) of registered LYWSDCGQ - LYWSDCGQData::onAdvData()
+ */
+void fuzzLYWSDCGQAdv( const uint8_t *data, size_t size );
+
+/**
+ * @brief MiBeacon frame - MiBeacon::objectsOffset() and MiBeacon::decodeObjects()
+ */
+void fuzzMiBeacon( const uint8_t *data, size_t size );
+
+/**
+ * @brief Service data (UUID LE, data) - advFormat() and AdvParser<> of detected format
+ */
+void fuzzAdvParser( const uint8_t *data, size_t size );
+
+/**
+ * @brief Value of LYWSD03MMC characteristic - parsers of data and history notifications
+ */
+void fuzzNotify( const uint8_t *data, size_t size );
+
+/**
+ * @brief Raw ADV payload from registered device - AD structures walk of BleAdvListener
+ */
+void fuzzAdvPayload( const uint8_t *data, size_t size );
+
+extern const FuzzTarget fuzzTargets[];
+extern const size_t     fuzzTargetCount;
+
+/* ************************************************************************** */
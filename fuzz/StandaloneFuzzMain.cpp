@@ -0,0 +1,109 @@
+/*
+ * Driver for compilers without libFuzzer (gcc) - runs fuzz target once for every file given on command line
+ * or found in given directory (seed corpus, crash reproducers). Together with sanitizers it checks
+ * that corpus is decoded without memory errors.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size );
+
+/* ************************************************************************** */
+/**
+ * @brief Runs fuzz target with content of file
+ * @param[in] path Path of file
+ * @return Returns false if file can't be read
+ */
+static bool runFile( const std::string &path )
+{
+	FILE *file = fopen( path.c_str(), "rb" );
+
+	if( file == nullptr )
+	{
+		fprintf( stderr, "Can't open %s\n", path.c_str() );
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t              buffer[4096];
+	size_t               length;
+
+	while( (length = fread( buffer, 1, sizeof( buffer ), file )) > 0 )
+	{
+		data.insert( data.end(), buffer, buffer + length );
+	}
+
+	fclose( file );
+
+	// copy with exact size - sanitizer detects reads behind input
+	std::vector<uint8_t> input( data );
+
+	LLVMFuzzerTestOneInput( input.data(), input.size() );
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+int main( int argc, char **argv )
+{
+	int executed = 0;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		struct stat st;
+
+		if( stat( argv[i], &st ) != 0 )
+		{
+			fprintf( stderr, "Can't find %s\n", argv[i] );
+			return 1;
+		}
+
+		if( S_ISDIR( st.st_mode ) )
+		{
+			DIR           *dir = opendir( argv[i] );
+			struct dirent *entry;
+
+			while( dir != nullptr && (entry = readdir( dir )) != nullptr )
+			{
+				std::string path = std::string( argv[i] ) + "/" + entry->d_name;
+
+				if( entry->d_name[0] != '.' && stat( path.c_str(), &st ) == 0 && S_ISREG( st.st_mode ) )
+				{
+					if( runFile( path ) == false )
+					{
+						return 1;
+					}
+
+					executed++;
+				}
+			}
+
+			if( dir != nullptr )
+			{
+				closedir( dir );
+			}
+		}
+		else
+		{
+			if( runFile( argv[i] ) == false )
+			{
+				return 1;
+			}
+
+			executed++;
+		}
+	}
+
+	printf( "Executed %d inputs\n", executed );
+
+	return executed ? 0 : 1;
+}
+
+/* ************************************************************************** */
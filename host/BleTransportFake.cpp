@@ -0,0 +1,620 @@
+#include "BleTransportFake.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+/* ************************************************************************** */
+
+BleTransportFake bleTransportFake;
+
+BleTransport *bleTransport = &bleTransportFake;
+
+static const char *sensorServiceUUID = "ebe0ccb0-7a0a-4b0c-8a1a-6ff2997da3a6";
+static const char *pvvxServiceUUID = "00001f10-0000-1000-8000-00805f9b34fb";
+
+/* ************************************************************************** */
+/**
+ * @brief Queue of fake BT task - allocated once and never freed, so detached thread never sees it destroyed
+ */
+struct FakeEventQueue
+{
+	std::mutex                                   lock;
+	std::condition_variable                      cond;
+	std::multimap<uint64_t, std::function<void()>> events; // by due time in ms
+	bool                                         started = false;
+};
+
+static FakeEventQueue       *eventQueue = new FakeEventQueue();
+static std::recursive_mutex *stateLock = new std::recursive_mutex();
+
+/* ************************************************************************** */
+
+static uint64_t nowMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/* ************************************************************************** */
+/**
+ * @brief Main function of fake BT task - runs due events one by one
+ */
+static void eventTaskMain()
+{
+	std::unique_lock<std::mutex> guard( eventQueue->lock );
+
+	for( ;; )
+	{
+		if( eventQueue->events.empty() )
+		{
+			eventQueue->cond.wait( guard );
+			continue;
+		}
+
+		auto     first = eventQueue->events.begin();
+		uint64_t now = nowMs();
+
+		if( first->first > now )
+		{
+			eventQueue->cond.wait_for( guard, std::chrono::milliseconds( first->first - now ) );
+			continue;
+		}
+
+		std::function<void()> event = first->second;
+
+		eventQueue->events.erase( first );
+
+		guard.unlock();
+		event();
+		guard.lock();
+	}
+}
+
+/* ************************************************************************** */
+
+void BleScannerFake::setCbk( BleScannerCbk *cbk )
+{
+	this->cbk = cbk;
+}
+
+/* ************************************************************************** */
+
+bool BleScannerFake::start( uint16_t interval, uint16_t window, uint32_t duration )
+{
+	startCount++;
+
+	if( startResult == false )
+	{
+		return false;
+	}
+
+	this->interval = interval;
+	this->window = window;
+	this->duration = duration;
+	running = true;
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+void BleScannerFake::stop()
+{
+	stopCount++;
+
+	if( asyncStop )
+	{
+		stopPending = true;
+		return;
+	}
+
+	running = false;
+
+	if( cbk != nullptr )
+	{
+		cbk->onScanComplete();
+	}
+}
+
+/* ************************************************************************** */
+
+void BleScannerFake::deliver( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi )
+{
+	if( cbk != nullptr )
+	{
+		cbk->onAdvReport( mac, payload, payloadLength, rssi );
+	}
+}
+
+/* ************************************************************************** */
+
+void BleScannerFake::complete()
+{
+	running = false;
+
+	if( cbk != nullptr )
+	{
+		cbk->onScanComplete();
+	}
+}
+
+/* ************************************************************************** */
+
+void BleScannerFake::completeStop()
+{
+	if( stopPending )
+	{
+		stopPending = false;
+		complete();
+	}
+}
+
+/* ************************************************************************** */
+
+void BleFakePeripheral::addCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t handle, uint16_t cccdHandle )
+{
+	chars.push_back( { serviceUUID, charUUID, handle, cccdHandle } );
+}
+
+/* ************************************************************************** */
+
+void BleFakePeripheral::notify( uint16_t handle, const uint8_t *data, size_t length )
+{
+	std::vector<uint8_t> value( data, data + length );
+
+	bleTransportFake.post( [this, handle, value]() {
+		std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+		if( client != nullptr )
+		{
+			client->deliverNotify( this, handle, value );
+		}
+	} );
+}
+
+/* ************************************************************************** */
+
+void BleGattClientFake::setCbk( BleGattClientCbk *cbk )
+{
+	this->cbk = cbk;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::connect( BLEAddress &address )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+	BleFakePeripheral                    *found = bleTransportFake.findPeripheral( address );
+
+	if( found == nullptr || found->connectable == false || found->client != nullptr )
+	{
+		return false;
+	}
+
+	peer = found;
+	peer->client = this;
+	peer->connectCount++;
+	discovered = false;
+	registered.clear();
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+void BleGattClientFake::disconnect()
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( peer != nullptr )
+	{
+		peer->client = nullptr;
+		peer = nullptr;
+	}
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::isConnected()
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	return peer != nullptr;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::findCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t *handle, uint16_t *cccdHandle )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( peer == nullptr )
+	{
+		return false;
+	}
+
+	if( discovered == false )
+	{
+		discovered = true;
+		peer->discoverCount++;
+	}
+
+	for( auto it = peer->chars.cbegin(); it != peer->chars.cend(); it++ )
+	{
+		if( it->serviceUUID == serviceUUID && it->charUUID == charUUID )
+		{
+			*handle = it->handle;
+
+			if( cccdHandle != nullptr )
+			{
+				*cccdHandle = it->cccdHandle;
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::read( uint16_t handle )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+	BleFakePeripheral                    *from = peer;
+
+	if( from == nullptr )
+	{
+		return false;
+	}
+
+	bleTransportFake.post( [this, from, handle]() {
+		std::lock_guard<std::recursive_mutex> guard( *stateLock );
+		std::vector<uint8_t>                  value;
+
+		if( peer != from || cbk == nullptr )
+		{
+			return;
+		}
+
+		bool ok = from->onRead( handle, value );
+
+		cbk->onRead( handle, ok, value.data(), value.size() );
+	} );
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::write( uint16_t handle, const uint8_t *data, size_t length )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( peer == nullptr )
+	{
+		return false;
+	}
+
+	peer->onWrite( handle, data, length );
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::writeDescriptor( uint16_t handle, const uint8_t *data, size_t length )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( peer == nullptr || length < 2 )
+	{
+		return false;
+	}
+
+	for( auto it = peer->chars.cbegin(); it != peer->chars.cend(); it++ )
+	{
+		if( it->cccdHandle == handle )
+		{
+			peer->onSubscribe( it->handle, (data[0] & 0x01) != 0 );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::registerNotify( uint16_t handle, bool doRegister )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( doRegister )
+	{
+		registered.insert( handle );
+	}
+	else
+	{
+		registered.erase( handle );
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+bool BleGattClientFake::updateConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	if( peer == nullptr )
+	{
+		return false;
+	}
+
+	peer->minInterval = minInterval;
+	peer->maxInterval = maxInterval;
+
+	return true;
+}
+
+/* ************************************************************************** */
+
+void BleGattClientFake::deliverNotify( BleFakePeripheral *from, uint16_t handle, const std::vector<uint8_t> &value )
+{
+	// as real stack - notifications of handles not registered locally are not passed to application
+	if( peer == from && cbk != nullptr && registered.count( handle ) )
+	{
+		cbk->onNotify( handle, value.data(), value.size() );
+	}
+}
+
+/* ************************************************************************** */
+
+BleScanner *BleTransportFake::createScanner( bool rawMode )
+{
+	lastScanner = new BleScannerFake();
+	lastScanner->continuous = rawMode;
+
+	return lastScanner;
+}
+
+/* ************************************************************************** */
+
+BleGattClient *BleTransportFake::createGattClient()
+{
+	return new BleGattClientFake();
+}
+
+/* ************************************************************************** */
+
+void BleTransportFake::addPeripheral( BleFakePeripheral *peripheral )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	peripherals.push_back( peripheral );
+}
+
+/* ************************************************************************** */
+
+BleFakePeripheral *BleTransportFake::findPeripheral( BLEAddress &address )
+{
+	std::lock_guard<std::recursive_mutex> guard( *stateLock );
+
+	for( auto it = peripherals.cbegin(); it != peripherals.cend(); it++ )
+	{
+		if( (*it)->getAddress().equals( address ) )
+		{
+			return *it;
+		}
+	}
+
+	return nullptr;
+}
+
+/* ************************************************************************** */
+
+void BleTransportFake::post( std::function<void()> event, uint32_t delayMs )
+{
+	std::lock_guard<std::mutex> guard( eventQueue->lock );
+
+	if( eventQueue->started == false )
+	{
+		eventQueue->started = true;
+		std::thread( eventTaskMain ).detach();
+	}
+
+	eventQueue->events.emplace( nowMs() + delayMs, event );
+	eventQueue->cond.notify_one();
+}
+
+/* ************************************************************************** */
+
+void BleTransportFake::lock()
+{
+	stateLock->lock();
+}
+
+/* ************************************************************************** */
+
+void BleTransportFake::unlock()
+{
+	stateLock->unlock();
+}
+
+/* ************************************************************************** */
+
+BleFakeLYWSD03MMC::BleFakeLYWSD03MMC( const BLEAddress &address, Firmware firmware ) : BleFakePeripheral( address )
+{
+	addCharacteristic( sensorServiceUUID, "ebe0ccc1-7a0a-4b0c-8a1a-6ff2997da3a6", DATA_HANDLE, DATA_CCCD_HANDLE );
+	addCharacteristic( sensorServiceUUID, "ebe0ccd8-7a0a-4b0c-8a1a-6ff2997da3a6", COMM_HANDLE );
+
+	if( firmware == FIRMWARE_STOCK )
+	{
+		addCharacteristic( sensorServiceUUID, "ebe0ccb7-7a0a-4b0c-8a1a-6ff2997da3a6", TIME_HANDLE );
+		addCharacteristic( sensorServiceUUID, "ebe0ccb9-7a0a-4b0c-8a1a-6ff2997da3a6", HIST_RANGE_HANDLE );
+		addCharacteristic( sensorServiceUUID, "ebe0ccba-7a0a-4b0c-8a1a-6ff2997da3a6", HIST_INDEX_HANDLE );
+		addCharacteristic( sensorServiceUUID, "ebe0ccbc-7a0a-4b0c-8a1a-6ff2997da3a6", HIST_DATA_HANDLE, HIST_CCCD_HANDLE );
+	}
+	else if( firmware == FIRMWARE_PVVX )
+	{
+		addCharacteristic( pvvxServiceUUID, "00001f1f-0000-1000-8000-00805f9b34fb", PVVX_CMD_HANDLE, PVVX_CCCD_HANDLE );
+	}
+}
+
+/* ************************************************************************** */
+
+void BleFakeLYWSD03MMC::addHistory( uint32_t timestamp )
+{
+	HistRecord record;
+
+	record.index = histFirst + history.size();
+	record.timestamp = timestamp;
+	record.tempMax = temp + 0.5;
+	record.humidityMax = humidity + 2;
+	record.tempMin = temp - 0.5;
+	record.humidityMin = humidity - 2;
+
+	history.push_back( record );
+}
+
+/* ************************************************************************** */
+
+std::vector<uint8_t> BleFakeLYWSD03MMC::encodeData()
+{
+	uint16_t t = (uint16_t) (int16_t) lroundf( temp * 100.0 );
+	uint16_t v = (uint16_t) lroundf( voltage * 1000.0 );
+
+	return { (uint8_t) t, (uint8_t) (t >> 8), humidity, (uint8_t) v, (uint8_t) (v >> 8) };
+}
+
+/* ************************************************************************** */
+
+uint32_t BleFakeLYWSD03MMC::sensorTime()
+{
+	return (uint32_t) (time( NULL ) + clockSkew);
+}
+
+/* ************************************************************************** */
+
+bool BleFakeLYWSD03MMC::onRead( uint16_t handle, std::vector<uint8_t> &value )
+{
+	if( handle == DATA_HANDLE && readable )
+	{
+		value = encodeData();
+		return true;
+	}
+
+	if( handle == TIME_HANDLE )
+	{
+		uint32_t now = sensorTime();
+
+		value = { (uint8_t) now, (uint8_t) (now >> 8), (uint8_t) (now >> 16), (uint8_t) (now >> 24) };
+		return true;
+	}
+
+	if( handle == HIST_RANGE_HANDLE )
+	{
+		uint32_t next = histFirst + history.size();
+
+		value = { (uint8_t) histFirst, (uint8_t) (histFirst >> 8), (uint8_t) (histFirst >> 16), (uint8_t) (histFirst >> 24),
+				(uint8_t) next, (uint8_t) (next >> 8), (uint8_t) (next >> 16), (uint8_t) (next >> 24) };
+		return true;
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+
+void BleFakeLYWSD03MMC::onWrite( uint16_t handle, const uint8_t *data, size_t length )
+{
+	if( handle == HIST_INDEX_HANDLE && length >= 4 )
+	{
+		histIndex = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+	}
+	else if( handle == PVVX_CMD_HANDLE && length >= 1 )
+	{
+		pvvxCommand( data, length );
+	}
+}
+
+/* ************************************************************************** */
+
+void BleFakeLYWSD03MMC::pvvxCommand( const uint8_t *data, size_t length )
+{
+	if( data[0] == 0x23 )
+	{
+		uint32_t now = sensorTime();
+		uint8_t  response[5] = { 0x23, (uint8_t) now, (uint8_t) (now >> 8), (uint8_t) (now >> 16), (uint8_t) (now >> 24) };
+
+		notify( PVVX_CMD_HANDLE, response, sizeof( response ) );
+	}
+	else if( data[0] == 0x35 && length >= 5 )
+	{
+		size_t  count = data[1] | (data[2] << 8);
+		size_t  skip = data[3] | (data[4] << 8);
+		uint8_t end[3] = { 0x35, 0, 0 };
+
+		// log is sent from the newest record, values are averages of hour
+		for( size_t i = skip; i < history.size() && i < skip + count; i++ )
+		{
+			const HistRecord &it = history[history.size() - 1 - i];
+			uint16_t          num = (uint16_t) (history.size() - i);
+			uint16_t          t = (uint16_t) (int16_t) lroundf( (it.tempMax + it.tempMin) * 50.0 );
+			uint16_t          h = (uint16_t) lroundf( (it.humidityMax + it.humidityMin) * 50.0 );
+			uint16_t          v = (uint16_t) lroundf( voltage * 1000.0 );
+			uint8_t           record[13] = { 0x35, (uint8_t) num, (uint8_t) (num >> 8),
+					(uint8_t) it.timestamp, (uint8_t) (it.timestamp >> 8), (uint8_t) (it.timestamp >> 16), (uint8_t) (it.timestamp >> 24),
+					(uint8_t) t, (uint8_t) (t >> 8), (uint8_t) h, (uint8_t) (h >> 8), (uint8_t) v, (uint8_t) (v >> 8) };
+
+			notify( PVVX_CMD_HANDLE, record, sizeof( record ) );
+		}
+
+		notify( PVVX_CMD_HANDLE, end, sizeof( end ) );
+	}
+}
+
+/* ************************************************************************** */
+
+void BleFakeLYWSD03MMC::onSubscribe( uint16_t handle, bool enabled )
+{
+	if( enabled == false )
+	{
+		return;
+	}
+
+	if( handle == DATA_HANDLE )
+	{
+		std::vector<uint8_t> value = encodeData();
+
+		// sensor sends its data few seconds after subscription
+		bleTransportFake.post( [this, value]() { notify( DATA_HANDLE, value.data(), value.size() ); }, notifyDelayMs );
+	}
+	else if( handle == HIST_DATA_HANDLE )
+	{
+		// burst of records from written index up to the newest one
+		for( auto it = history.cbegin(); it != history.cend(); it++ )
+		{
+			if( it->index < histIndex )
+			{
+				continue;
+			}
+
+			uint16_t maxT = (uint16_t) (int16_t) lroundf( it->tempMax * 10.0 );
+			uint16_t minT = (uint16_t) (int16_t) lroundf( it->tempMin * 10.0 );
+			uint8_t  record[14] = {
+				(uint8_t) it->index, (uint8_t) (it->index >> 8), (uint8_t) (it->index >> 16), (uint8_t) (it->index >> 24),
+				(uint8_t) it->timestamp, (uint8_t) (it->timestamp >> 8), (uint8_t) (it->timestamp >> 16), (uint8_t) (it->timestamp >> 24),
+				(uint8_t) maxT, (uint8_t) (maxT >> 8), it->humidityMax, (uint8_t) minT, (uint8_t) (minT >> 8), it->humidityMin };
+
+			notify( HIST_DATA_HANDLE, record, sizeof( record ) );
+		}
+	}
+}
+
+/* ************************************************************************** */
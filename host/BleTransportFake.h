@@ -0,0 +1,319 @@
+#pragma once
+
+#include "Arduino.h"
+#include "BleTransport.h"
+#include <functional>
+#include <string>
+#include <vector>
+#include <set>
+
+/*
+ * In-process fake of BLE stack for native host build. ADV reports are delivered by test code, GATT events
+ * (notifications, read results) are delivered asynchronously from own "BT task" thread as with real stack.
+ */
+
+/* ************************************************************************** */
+/**
+ * @brief Fake scanner - test code delivers ADV reports and finishes scans
+ */
+class BleScannerFake : public BleScanner
+{
+public:
+	bool     startResult = true;  // result returned by start()
+	bool     continuous = true;   // scanner supports continuous scan
+	bool     asyncStop = false;   // stop() is finished only by completeStop() (as raw GAP scan)
+	bool     running = false;     // scan is running
+	bool     stopPending = false; // stop() was called and it was not finished yet
+	uint32_t startCount = 0;      // number of start() calls
+	uint32_t stopCount = 0;       // number of stop() calls
+	uint16_t interval = 0;        // parameters of the last start()
+	uint16_t window = 0;
+	uint32_t duration = 0;
+
+	void setCbk( BleScannerCbk *cbk );
+	bool start( uint16_t interval, uint16_t window, uint32_t duration );
+	void stop();
+
+	bool canRunContinuous()
+	{
+		return continuous;
+	}
+
+	/**
+	 * @brief Delivers ADV report to callback as if it was received by radio
+	 * @param[in] mac Address of device which sent the packet
+	 * @param[in] payload Raw ADV payload (AD structures)
+	 * @param[in] payloadLength Length of raw ADV payload
+	 * @param[in] rssi RSSI of packet in dBm
+	 */
+	void deliver( const uint8_t *mac, const uint8_t *payload, size_t payloadLength, int8_t rssi = ADV_RSSI_UNKNOWN );
+
+	/**
+	 * @brief Finishes running scan as if its duration expired
+	 */
+	void complete();
+
+	/**
+	 * @brief Finishes stop requested by stop() in asynchronous mode
+	 */
+	void completeStop();
+
+private:
+	BleScannerCbk *cbk = nullptr;
+};
+
+/* ************************************************************************** */
+
+class BleGattClientFake;
+
+/**
+ * @brief Fake GATT server of one device. Subclasses model behaviour of real devices.
+ */
+class BleFakePeripheral
+{
+public:
+	uint32_t connectCount = 0;   // number of connections
+	uint32_t discoverCount = 0;  // number of service discoveries
+	bool     connectable = true; // device accepts connections
+	uint16_t minInterval = 0;    // connection parameters requested by the last update
+	uint16_t maxInterval = 0;
+
+	/**
+	 * @brief Creates peripheral
+	 * @param[in] address Address of device
+	 */
+	BleFakePeripheral( const BLEAddress &address ) : address( address ) {}
+
+	virtual ~BleFakePeripheral() {}
+
+	/**
+	 * @brief Adds characteristic to GATT table
+	 * @param[in] serviceUUID UUID of service
+	 * @param[in] charUUID UUID of characteristic
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] cccdHandle Handle of client characteristic configuration descriptor (0 = characteristic doesn't have it)
+	 */
+	void addCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t handle, uint16_t cccdHandle = 0 );
+
+	/**
+	 * @brief Method called when characteristic is read
+	 * @param[in] handle Handle of characteristic
+	 * @param[out] value Value of characteristic
+	 * @return Returns false if read is answered with error
+	 */
+	virtual bool onRead( uint16_t handle, std::vector<uint8_t> &value )
+	{
+		return false;
+	}
+
+	/**
+	 * @brief Method called when characteristic is written
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] data Written value
+	 * @param[in] length Length of value
+	 */
+	virtual void onWrite( uint16_t handle, const uint8_t *data, size_t length ) {}
+
+	/**
+	 * @brief Method called when notifications of characteristic are enabled or disabled by CCCD write
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] enabled true if notifications were enabled
+	 */
+	virtual void onSubscribe( uint16_t handle, bool enabled ) {}
+
+	/**
+	 * @brief Sends notification to connected client (delivered asynchronously)
+	 * @param[in] handle Handle of characteristic
+	 * @param[in] data Value of characteristic
+	 * @param[in] length Length of value
+	 */
+	void notify( uint16_t handle, const uint8_t *data, size_t length );
+
+	BLEAddress &getAddress()
+	{
+		return address;
+	}
+
+private:
+	struct Characteristic
+	{
+		std::string serviceUUID;
+		std::string charUUID;
+		uint16_t    handle;
+		uint16_t    cccdHandle;
+	};
+
+	BLEAddress                  address;
+	std::vector<Characteristic> chars;
+	BleGattClientFake          *client = nullptr; // connected client
+
+	friend class BleGattClientFake;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Fake GATT client connecting to peripherals added to fake transport
+ */
+class BleGattClientFake : public BleGattClient
+{
+public:
+	void setCbk( BleGattClientCbk *cbk );
+	bool connect( BLEAddress &address );
+	void disconnect();
+	bool isConnected();
+	bool findCharacteristic( const char *serviceUUID, const char *charUUID, uint16_t *handle, uint16_t *cccdHandle = nullptr );
+	bool read( uint16_t handle );
+	bool write( uint16_t handle, const uint8_t *data, size_t length );
+	bool writeDescriptor( uint16_t handle, const uint8_t *data, size_t length );
+	bool registerNotify( uint16_t handle, bool doRegister );
+	bool updateConnParams( uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout );
+
+private:
+	BleGattClientCbk   *cbk = nullptr;
+	BleFakePeripheral  *peer = nullptr;    // connected peripheral
+	bool                discovered = false; // services were discovered in this connection
+	std::set<uint16_t>  registered;        // handles registered for notifications
+
+	/**
+	 * @brief Delivers notification from peripheral (called from fake BT task)
+	 */
+	void deliverNotify( BleFakePeripheral *from, uint16_t handle, const std::vector<uint8_t> &value );
+
+	friend class BleFakePeripheral;
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Fake transport - owns peripherals and fake BT task delivering GATT events
+ */
+class BleTransportFake : public BleTransport
+{
+public:
+	BleScanner *createScanner( bool rawMode );
+	BleGattClient *createGattClient();
+
+	/**
+	 * @brief Adds peripheral which can be connected by GATT clients
+	 * @param[in] peripheral Peripheral (must outlive transport)
+	 */
+	void addPeripheral( BleFakePeripheral *peripheral );
+
+	/**
+	 * @brief Finds peripheral by address
+	 * @param[in] address Address of device
+	 * @return Returns peripheral or nullptr if there is no such peripheral
+	 */
+	BleFakePeripheral *findPeripheral( BLEAddress &address );
+
+	/**
+	 * @brief Runs event in fake BT task - events are run one by one in order of posting
+	 * @param[in] event Event to run
+	 * @param[in] delayMs Delay of event in ms
+	 */
+	void post( std::function<void()> event, uint32_t delayMs = 0 );
+
+	/**
+	 * @brief Locks state shared between fake BT task and callers
+	 */
+	void lock();
+	void unlock();
+
+	BleScannerFake *lastScanner = nullptr; // scanner created by the last createScanner()
+
+private:
+	std::vector<BleFakePeripheral *> peripherals;
+};
+
+/* ************************************************************************** */
+
+extern BleTransportFake bleTransportFake;
+
+/* ************************************************************************** */
+/**
+ * @brief Fake LYWSD03MMC sensor with original firmware - data characteristic, communication interval
+ * and hourly history
+ */
+class BleFakeLYWSD03MMC : public BleFakePeripheral
+{
+public:
+	static const uint16_t DATA_HANDLE = 0x36;
+	static const uint16_t DATA_CCCD_HANDLE = 0x37;
+	static const uint16_t COMM_HANDLE = 0x4a;
+	static const uint16_t HIST_RANGE_HANDLE = 0x24;
+	static const uint16_t HIST_INDEX_HANDLE = 0x28;
+	static const uint16_t HIST_DATA_HANDLE = 0x2c;
+	static const uint16_t HIST_CCCD_HANDLE = 0x2d;
+	static const uint16_t TIME_HANDLE = 0x20;
+	static const uint16_t PVVX_CMD_HANDLE = 0x5a;
+	static const uint16_t PVVX_CCCD_HANDLE = 0x5b;
+
+	/**
+	 * @brief Firmware of sensor - determines its GATT table
+	 */
+	enum Firmware
+	{
+		FIRMWARE_STOCK,      // original firmware with hourly history
+		FIRMWARE_NO_HISTORY, // custom firmware without history (atc1441)
+		FIRMWARE_PVVX,       // pvvx firmware with log read by commands
+	};
+
+	/**
+	 * @brief One record of hourly history in sensor memory
+	 */
+	struct HistRecord
+	{
+		uint32_t index;
+		uint32_t timestamp; // by sensor clock
+		float    tempMax;
+		uint8_t  humidityMax;
+		float    tempMin;
+		uint8_t  humidityMin;
+	};
+
+	float    temp = 21.5;
+	uint8_t  humidity = 45;
+	float    voltage = 2.95;
+	bool     readable = true;        // data characteristic can be read directly
+	uint32_t notifyDelayMs = 0;      // delay of data notification after subscription
+	std::vector<HistRecord> history; // records in sensor memory (oldest first)
+	uint32_t histFirst = 0;          // index of the oldest record
+	uint32_t histIndex = 0;          // start index written by client
+	int32_t  clockSkew = 0;          // sensor clock minus real clock in seconds
+
+	/**
+	 * @brief Creates sensor
+	 * @param[in] address Address of sensor
+	 * @param[in] firmware Firmware of sensor
+	 */
+	BleFakeLYWSD03MMC( const BLEAddress &address, Firmware firmware = FIRMWARE_STOCK );
+
+	/**
+	 * @brief Adds one history record - as sensor does every hour
+	 * @param[in] timestamp Start of hour by sensor clock
+	 */
+	void addHistory( uint32_t timestamp );
+
+	bool onRead( uint16_t handle, std::vector<uint8_t> &value );
+	void onWrite( uint16_t handle, const uint8_t *data, size_t length );
+	void onSubscribe( uint16_t handle, bool enabled );
+
+private:
+	/**
+	 * @brief Encodes actual values as data characteristic
+	 */
+	std::vector<uint8_t> encodeData();
+
+	/**
+	 * @brief Returns actual time by sensor clock
+	 */
+	uint32_t sensorTime();
+
+	/**
+	 * @brief Answers command of pvvx firmware by notifications
+	 * @param[in] data Written command
+	 * @param[in] length Length of command
+	 */
+	void pvvxCommand( const uint8_t *data, size_t length );
+};
+
+/* ************************************************************************** */
@@ -0,0 +1,88 @@
+#include "ccm.h"
+
+#include <string.h>
+
+/* ************************************************************************** */
+
+void mbedtls_ccm_init( mbedtls_ccm_context *ctx )
+{
+	memset( ctx, 0, sizeof( mbedtls_ccm_context ) );
+}
+
+/* ************************************************************************** */
+
+int mbedtls_ccm_setkey( mbedtls_ccm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key, unsigned int keybits )
+{
+	if( cipher != MBEDTLS_CIPHER_ID_AES || keybits != 128 )
+	{
+		return MBEDTLS_ERR_CCM_BAD_INPUT;
+	}
+
+	ccm_aes128_set_key( &ctx->aes, key );
+	ctx->keySet = 1;
+
+	return 0;
+}
+
+/* ************************************************************************** */
+
+void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
+{
+	// expanded key must not stay in memory
+	memset( ctx, 0, sizeof( mbedtls_ccm_context ) );
+}
+
+/* ************************************************************************** */
+
+int mbedtls_ccm_encrypt_and_tag( mbedtls_ccm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+		const unsigned char *add, size_t add_len, const unsigned char *input, unsigned char *output,
+		unsigned char *tag, size_t tag_len )
+{
+	if( ctx->keySet == 0 || iv_len < 7 || iv_len > 13 || tag_len < 4 || tag_len > 16 || (tag_len & 1) )
+	{
+		return MBEDTLS_ERR_CCM_BAD_INPUT;
+	}
+
+	ccm_aes128_set_nonce( &ctx->aes, iv_len, iv, add_len, length, tag_len );
+	ccm_aes128_update( &ctx->aes, add_len, add );
+	ccm_aes128_encrypt( &ctx->aes, length, output, input );
+	ccm_aes128_digest( &ctx->aes, tag_len, tag );
+
+	return 0;
+}
+
+/* ************************************************************************** */
+
+int mbedtls_ccm_auth_decrypt( mbedtls_ccm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+		const unsigned char *add, size_t add_len, const unsigned char *input, unsigned char *output,
+		const unsigned char *tag, size_t tag_len )
+{
+	uint8_t digest[16];
+	uint8_t diff = 0;
+
+	if( ctx->keySet == 0 || iv_len < 7 || iv_len > 13 || tag_len < 4 || tag_len > 16 || (tag_len & 1) )
+	{
+		return MBEDTLS_ERR_CCM_BAD_INPUT;
+	}
+
+	ccm_aes128_set_nonce( &ctx->aes, iv_len, iv, add_len, length, tag_len );
+	ccm_aes128_update( &ctx->aes, add_len, add );
+	ccm_aes128_decrypt( &ctx->aes, length, output, input );
+	ccm_aes128_digest( &ctx->aes, tag_len, digest );
+
+	// constant time compare - as mbedtls
+	for( size_t i = 0; i < tag_len; i++ )
+	{
+		diff |= digest[i] ^ tag[i];
+	}
+
+	if( diff != 0 )
+	{
+		memset( output, 0, length );
+		return MBEDTLS_ERR_CCM_AUTH_FAILED;
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** */
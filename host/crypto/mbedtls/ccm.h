@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Subset of mbedtls CCM API implemented by nettle - used by native host build when mbedtls headers are not
+ * installed. Context keeps expanded AES key, so setkey is done once per key as with mbedtls.
+ */
+
+#include <stddef.h>
+#include <nettle/ccm.h>
+
+#define MBEDTLS_ERR_CCM_BAD_INPUT    -0x000D
+#define MBEDTLS_ERR_CCM_AUTH_FAILED  -0x000F
+
+typedef enum
+{
+	MBEDTLS_CIPHER_ID_NONE = 0,
+	MBEDTLS_CIPHER_ID_NULL,
+	MBEDTLS_CIPHER_ID_AES,
+} mbedtls_cipher_id_t;
+
+typedef struct
+{
+	struct ccm_aes128_ctx aes;
+	int                   keySet;
+} mbedtls_ccm_context;
+
+void mbedtls_ccm_init( mbedtls_ccm_context *ctx );
+
+int mbedtls_ccm_setkey( mbedtls_ccm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key, unsigned int keybits );
+
+void mbedtls_ccm_free( mbedtls_ccm_context *ctx );
+
+int mbedtls_ccm_encrypt_and_tag( mbedtls_ccm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+		const unsigned char *add, size_t add_len, const unsigned char *input, unsigned char *output,
+		unsigned char *tag, size_t tag_len );
+
+int mbedtls_ccm_auth_decrypt( mbedtls_ccm_context *ctx, size_t length, const unsigned char *iv, size_t iv_len,
+		const unsigned char *add, size_t add_len, const unsigned char *input, unsigned char *output,
+		const unsigned char *tag, size_t tag_len );
@@ -0,0 +1,135 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+
+/* ************************************************************************** */
+/**
+ * @brief Task of host build - thread with notification count
+ */
+struct HostTask
+{
+	std::mutex              lock;
+	std::condition_variable cond;
+	uint32_t                count = 0;
+};
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+static std::mt19937 randomGen( 1 ); // fixed seed - simulations are repeatable
+
+static thread_local HostTask *currentTask = nullptr;
+
+/* ************************************************************************** */
+
+uint32_t millis()
+{
+	return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+/* ************************************************************************** */
+
+uint32_t micros()
+{
+	return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - startTime ).count();
+}
+
+/* ************************************************************************** */
+
+void delay( uint32_t ms )
+{
+	std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+}
+
+/* ************************************************************************** */
+
+long random( long max )
+{
+	return random( 0, max );
+}
+
+/* ************************************************************************** */
+
+long random( long min, long max )
+{
+	if( max <= min )
+	{
+		return min;
+	}
+
+	return min + (long) (randomGen() % (uint32_t) (max - min));
+}
+
+/* ************************************************************************** */
+
+BaseType_t xTaskCreate( TaskFunction_t function, const char *name, uint32_t stackDepth, void *param, uint32_t priority, TaskHandle_t *handle )
+{
+	// task is never deleted (as tasks of gateway) - it must outlive its thread
+	HostTask *task = new HostTask();
+
+	if( handle != nullptr )
+	{
+		*handle = task;
+	}
+
+	std::thread( [task, function, param]() {
+		currentTask = task;
+		function( param );
+	} ).detach();
+
+	return pdPASS;
+}
+
+/* ************************************************************************** */
+
+uint32_t ulTaskNotifyTake( BaseType_t clearOnExit, TickType_t ticksToWait )
+{
+	// thread not created by xTaskCreate() (e.g. main) gets its own notification count
+	if( currentTask == nullptr )
+	{
+		currentTask = new HostTask();
+	}
+
+	HostTask                    *task = currentTask;
+	std::unique_lock<std::mutex> guard( task->lock );
+
+	if( ticksToWait == portMAX_DELAY )
+	{
+		task->cond.wait( guard, [task]() { return task->count != 0; } );
+	}
+	else
+	{
+		task->cond.wait_for( guard, std::chrono::milliseconds( ticksToWait ), [task]() { return task->count != 0; } );
+	}
+
+	uint32_t count = task->count;
+
+	if( count )
+	{
+		task->count = clearOnExit ? 0 : count - 1;
+	}
+
+	return count;
+}
+
+/* ************************************************************************** */
+
+void xTaskNotifyGive( TaskHandle_t task )
+{
+	std::lock_guard<std::mutex> guard( task->lock );
+
+	task->count++;
+	task->cond.notify_one();
+}
+
+/* ************************************************************************** */
+
+TickType_t xTaskGetTickCount()
+{
+	return millis();
+}
+
+/* ************************************************************************** */
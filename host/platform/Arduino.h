@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Minimal Arduino and FreeRTOS API used by gateway core - only for native host build (tests, benchmarks, fuzzing).
+ * Tasks are threads, task notifications are counting semaphores and one tick is one millisecond.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <string>
+
+/* ************************************************************************** */
+
+#define constrain( amt, low, high )  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+/**
+ * @brief Returns number of milliseconds since start of program
+ */
+uint32_t millis();
+
+/**
+ * @brief Returns number of microseconds since start of program
+ */
+uint32_t micros();
+
+/**
+ * @brief Sleeps calling thread
+ * @param[in] ms Time in milliseconds
+ */
+void delay( uint32_t ms );
+
+/**
+ * @brief Returns pseudo-random number
+ * @param[in] max Upper bound (exclusive)
+ * @return Returns number from 0 to max - 1
+ */
+long random( long max );
+
+/**
+ * @brief Returns pseudo-random number
+ * @param[in] min Lower bound (inclusive)
+ * @param[in] max Upper bound (exclusive)
+ * @return Returns number from min to max - 1
+ */
+long random( long min, long max );
+
+/* ************************************************************************** */
+/**
+ * @brief Byte stream - only reading used by replay of captures
+ */
+class Stream
+{
+public:
+	virtual ~Stream() {}
+
+	/**
+	 * @brief Reads bytes from stream
+	 * @param[out] buffer Read bytes
+	 * @param[in] length Number of bytes to read
+	 * @return Returns number of read bytes (less than length at end of stream)
+	 */
+	virtual size_t readBytes( char *buffer, size_t length ) = 0;
+
+	size_t readBytes( uint8_t *buffer, size_t length )
+	{
+		return readBytes( (char *) buffer, length );
+	}
+};
+
+/* ************************************************************************** */
+
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef void     (*TaskFunction_t)( void * );
+typedef struct HostTask *TaskHandle_t;
+
+#define pdTRUE                 1
+#define pdFALSE                0
+#define pdPASS                 1
+#define portMAX_DELAY          0xffffffffu
+#define pdMS_TO_TICKS( ms )    ((TickType_t) (ms))
+
+/**
+ * @brief Creates task - task runs in own detached thread
+ * @param[in] function Main function of task
+ * @param[in] name Name of task
+ * @param[in] stackDepth Stack size (ignored)
+ * @param[in] param Parameter passed to main function
+ * @param[in] priority Priority of task (ignored)
+ * @param[out] handle Handle of created task
+ * @return Returns pdPASS
+ */
+BaseType_t xTaskCreate( TaskFunction_t function, const char *name, uint32_t stackDepth, void *param, uint32_t priority, TaskHandle_t *handle );
+
+/**
+ * @brief Waits for notification of calling task
+ * @param[in] clearOnExit pdTRUE clears notification count, pdFALSE decrements it
+ * @param[in] ticksToWait Max. time to wait in ticks (portMAX_DELAY = forever)
+ * @return Returns notification count before it was cleared or decremented (0 = timeout)
+ */
+uint32_t ulTaskNotifyTake( BaseType_t clearOnExit, TickType_t ticksToWait );
+
+/**
+ * @brief Notifies task - increments its notification count
+ * @param[in] task Task to notify
+ */
+void xTaskNotifyGive( TaskHandle_t task );
+
+/**
+ * @brief Returns tick count since start of program
+ */
+TickType_t xTaskGetTickCount();
+
+/* ************************************************************************** */
@@ -0,0 +1,54 @@
+#include "BLEAddress.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* ************************************************************************** */
+
+BLEAddress::BLEAddress( esp_bd_addr_t address )
+{
+	memcpy( m_address, address, sizeof( esp_bd_addr_t ) );
+}
+
+/* ************************************************************************** */
+
+BLEAddress::BLEAddress( std::string stringAddress )
+{
+	unsigned int data[6] = { 0 };
+
+	// malformed address (e.g. placeholder "XX") gives zero bytes as in ESP32 library
+	sscanf( stringAddress.c_str(), "%x:%x:%x:%x:%x:%x", &data[0], &data[1], &data[2], &data[3], &data[4], &data[5] );
+
+	for( int i = 0; i < 6; i++ )
+	{
+		m_address[i] = (uint8_t) data[i];
+	}
+}
+
+/* ************************************************************************** */
+
+bool BLEAddress::equals( BLEAddress otherAddress )
+{
+	return memcmp( otherAddress.getNative(), m_address, sizeof( esp_bd_addr_t ) ) == 0;
+}
+
+/* ************************************************************************** */
+
+esp_bd_addr_t *BLEAddress::getNative()
+{
+	return &m_address;
+}
+
+/* ************************************************************************** */
+
+std::string BLEAddress::toString()
+{
+	char buffer[18];
+
+	snprintf( buffer, sizeof( buffer ), "%02x:%02x:%02x:%02x:%02x:%02x",
+			m_address[0], m_address[1], m_address[2], m_address[3], m_address[4], m_address[5] );
+
+	return std::string( buffer );
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * BLEAddress with the same interface as in ESP32 BLE library - only for native host build.
+ */
+
+#include <stdint.h>
+#include <string>
+
+typedef uint8_t esp_bd_addr_t[6];
+
+/* ************************************************************************** */
+/**
+ * @brief Address of BLE device
+ */
+class BLEAddress
+{
+public:
+	/**
+	 * @brief Creates address from native representation
+	 * @param[in] address Address bytes (the most significant byte first)
+	 */
+	BLEAddress( esp_bd_addr_t address );
+
+	/**
+	 * @brief Creates address from string
+	 * @param[in] stringAddress Address in format "xx:xx:xx:xx:xx:xx"
+	 */
+	BLEAddress( std::string stringAddress );
+
+	/**
+	 * @brief Compares two addresses
+	 * @param[in] otherAddress Address to compare with
+	 * @return Returns true if addresses are equal
+	 */
+	bool equals( BLEAddress otherAddress );
+
+	/**
+	 * @brief Returns native representation of address
+	 */
+	esp_bd_addr_t *getNative();
+
+	/**
+	 * @brief Returns address as string in format "xx:xx:xx:xx:xx:xx"
+	 */
+	std::string toString();
+
+private:
+	esp_bd_addr_t m_address;
+};
+
+/* ************************************************************************** */
@@ -1,6 +1,7 @@
 #include "mitemp_ble_gw_esp32.h"
 
 #include <WebServer.h>
+#include "BleTransportEsp32.h"
 #include "BleAdvListener.h"
 #include "LYWSD03MMC.h"
 #include "LYWSDCGQ.h"
@@ -87,6 +88,94 @@ String handle_temp( void )
 
 /* ************************************************************************** */
 
+String handle_stats( void )
+{
+	String response = "";
+	struct SensorStats stats;
+	char buff[100];
+
+	snprintf( buff, sizeof( buff ), "listening, %.3f, ring dropped, %u, ring high water, %u\n",
+			bleAdvListener.getListeningFraction(), bleAdvListener.getRingDropped(), bleAdvListener.getRingHighWater() );
+	response += buff;
+
+	for( int i = 0; i < MY_DEVICES_COUNT; i++ )
+	{
+		if( MyDevices[i].isLYWSD03MMC )
+		{
+			lywsd03mmc.getStats( MyDevices[i].address, &stats );
+		}
+		else
+		{
+			lywsdcgq.getStats( MyDevices[i].address, &stats );
+		}
+
+		// the same "name, value" pairs as in listener line, so columns don't have to be known by position
+		snprintf( buff, sizeof( buff ), "%s, adv, %u, adv duplicates, %u", MyDevices[i].alias, stats.advCount, stats.advDuplicates );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", refreshes, %u, refreshes skipped, %u, refresh late last, %ld, refresh late max, %ld",
+				stats.refreshCount, stats.refreshSkipped, (long)stats.refreshLateLast, (long)stats.refreshLateMax );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", conn data time, %u", stats.connDataTimeLast );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", read ok, %u, read failed, %u, read time avg, %u, notify ok, %u, notify time avg, %u",
+				stats.readOk, stats.readFailed, stats.readOk ? stats.readTimeTotal / stats.readOk : 0,
+				stats.notifyOk, stats.notifyOk ? stats.notifyTimeTotal / stats.notifyOk : 0 );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", conn failed, %u, conn fail streak, %u, breaker open, %d",
+				stats.connFailed, stats.connFailStreak, stats.breakerOpen ? 1 : 0 );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", link time last, %u, link time avg, %u",
+				stats.linkTimeLast, stats.linkCount ? stats.linkTimeTotal / stats.linkCount : 0 );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", refresh interval, %ld", (long)stats.refreshInterval );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", rssi, %.0f", stats.rssi );
+		response += buff;
+
+		snprintf( buff, sizeof( buff ), ", history records, %u", stats.histRecords );
+		response += buff;
+
+		response += "\n";
+	}
+
+	return response;
+}
+
+/* ************************************************************************** */
+
+String handle_history( void )
+{
+	String response = "";
+	LYWSD03MMCHistory records[LYWSD03MMC_HISTORY_SIZE];
+	char buff[100];
+
+	for( int i = 0; i < MY_DEVICES_COUNT; i++ )
+	{
+		if( MyDevices[i].isLYWSD03MMC )
+		{
+			size_t count = lywsd03mmc.getHistory( MyDevices[i].address, records, LYWSD03MMC_HISTORY_SIZE );
+
+			for( size_t j = 0; j < count; j++ )
+			{
+				snprintf( buff, sizeof( buff ), "%s, %u, %ld, %.1f, %.1f, %.0f, %.0f\n", MyDevices[i].alias, records[j].index,
+						(long)records[j].timestamp, records[j].tempMin, records[j].tempMax, records[j].humidityMin, records[j].humidityMax );
+				response += buff;
+			}
+		}
+	}
+
+	return response;
+}
+
+/* ************************************************************************** */
+
 class LYWSD03MMCChangeCbk : public SensorDataChangeCbk
 {
 public:
@@ -183,6 +272,14 @@ void setup()
 		web_server.send(200, "text/plain", handle_temp() );
 	});
 
+	web_server.on("/stats", HTTP_GET, []() {
+		web_server.send(200, "text/plain", handle_stats() );
+	});
+
+	web_server.on("/history", HTTP_GET, []() {
+		web_server.send(200, "text/plain", handle_history() );
+	});
+
 	web_server.onNotFound( []() {
 		web_server.send( 404, "text/plain", "not found" );
 	});
@@ -196,6 +293,7 @@ void setup()
 
 	bleAdvListener.init();
 	lywsd03mmc.init( lywsd03mmcDataRefresh );
+//	lywsd03mmc.setBackfill( 24 ); // uncomment to download hourly history from sensor memory (shown by /history)
     lywsdcgq.init( 60 );
 
 	for( int i = 0; i < MY_DEVICES_COUNT; i++ )
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include "AdvPayload.h"
+#include "BleAdvIndex.h"
+#include "BleAdvListener.h"
+#include "BleTransportFake.h"
+#include "LYWSDCGQ.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+/* ************************************************************************** */
+
+// all heap allocations of test binary go through these operators, only counting can be switched on
+static std::atomic<bool>     countingEnabled( false );
+static std::atomic<uint32_t> allocationCount( 0 );
+
+void *operator new( size_t size )
+{
+	if( countingEnabled.load( std::memory_order_relaxed ) )
+	{
+		allocationCount++;
+	}
+
+	void *ptr = malloc( size ? size : 1 );
+
+	if( ptr == nullptr )
+	{
+		throw std::bad_alloc();
+	}
+
+	return ptr;
+}
+
+void *operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void *ptr ) noexcept
+{
+	free( ptr );
+}
+
+void operator delete[]( void *ptr ) noexcept
+{
+	free( ptr );
+}
+
+void operator delete( void *ptr, size_t size ) noexcept
+{
+	free( ptr );
+}
+
+void operator delete[]( void *ptr, size_t size ) noexcept
+{
+	free( ptr );
+}
+
+/**
+ * @brief Counts heap allocations done while object exists (in all threads)
+ */
+class AllocationCounter
+{
+public:
+	AllocationCounter()
+	{
+		allocationCount = 0;
+		countingEnabled = true;
+	}
+
+	~AllocationCounter()
+	{
+		countingEnabled = false;
+	}
+
+	uint32_t count()
+	{
+		return allocationCount.load();
+	}
+};
+
+/* ************************************************************************** */
+/**
+ * @brief Callback which only reads borrowed data
+ */
+class SummingCbk : public BleAdvListenerCbk
+{
+public:
+	uint32_t sum = 0;
+
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
+	{
+		for( size_t i = 0; i < serviceData.length; i++ )
+		{
+			sum += serviceData.data[i];
+		}
+	}
+};
+
+static uint8_t mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0x30, 0x00, 0x01 };
+
+// flags, service data of atc1441 firmware and service data of MiBeacon
+static const uint8_t payload[] = {
+	0x02, 0x01, 0x06,
+	0x05, BLE_AD_TYPE_SERVICE_DATA, 0x1A, 0x18, 0x11, 0x22,
+	0x06, BLE_AD_TYPE_SERVICE_DATA, 0x95, 0xFE, 0x50, 0x20, 0xAA,
+};
+
+/* ************************************************************************** */
+
+TEST( Allocation, ServiceDataAreWalkedWithoutHeap )
+{
+	uint32_t sum = 0;
+	uint32_t blocks = 0;
+
+	{
+		AllocationCounter counter;
+
+		for( int i = 0; i < 100; i++ )
+		{
+			size_t      offset = 0;
+			uint16_t    uuid;
+			AdvDataView serviceData;
+
+			while( advNextServiceData( payload, sizeof( payload ), &offset, &uuid, &serviceData ) )
+			{
+				blocks++;
+				sum += uuid;
+
+				for( size_t j = 0; j < serviceData.length; j++ )
+				{
+					sum += serviceData.data[j];
+				}
+			}
+		}
+
+		EXPECT_EQ( counter.count(), 0u );
+	}
+
+	EXPECT_EQ( blocks, 200u );
+	EXPECT_EQ( sum, 100u * (0x181A + 0x11 + 0x22 + 0xFE95 + 0x50 + 0x20 + 0xAA) );
+}
+
+/* ************************************************************************** */
+
+TEST( Allocation, ServiceDataPointToReceivedPayload )
+{
+	size_t      offset = 0;
+	uint16_t    uuid;
+	AdvDataView serviceData;
+
+	ASSERT_TRUE( advNextServiceData( payload, sizeof( payload ), &offset, &uuid, &serviceData ) );
+	EXPECT_EQ( uuid, 0x181A );
+	EXPECT_EQ( serviceData.data, payload + 7 );
+	EXPECT_EQ( serviceData.length, 2u );
+
+	ASSERT_TRUE( advNextServiceData( payload, sizeof( payload ), &offset, &uuid, &serviceData ) );
+	EXPECT_EQ( uuid, 0xFE95 );
+	EXPECT_EQ( serviceData.data, payload + 13 );
+	EXPECT_EQ( serviceData.length, 3u );
+
+	EXPECT_FALSE( advNextServiceData( payload, sizeof( payload ), &offset, &uuid, &serviceData ) );
+
+	// AD structure longer than payload is not used
+	offset = 0;
+	EXPECT_FALSE( advNextServiceData( payload, 8, &offset, &uuid, &serviceData ) );
+}
+
+/* ************************************************************************** */
+
+TEST( Allocation, AddressIsFoundWithoutHeap )
+{
+	BleAdvIndex index;
+	int         cbk;
+	uint8_t     other[BLE_ADDRESS_LEN] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+
+	// index only stores callback pointer, it is never called here
+	index.insert( mac, reinterpret_cast<BleAdvListenerCbk *>( &cbk ) );
+
+	{
+		AllocationCounter counter;
+
+		for( int i = 0; i < 100; i++ )
+		{
+			EXPECT_EQ( index.find( mac ), reinterpret_cast<BleAdvListenerCbk *>( &cbk ) );
+			EXPECT_EQ( index.find( other ), nullptr );
+		}
+
+		EXPECT_EQ( counter.count(), 0u );
+	}
+}
+
+/* ************************************************************************** */
+
+TEST( Allocation, ReceivedAdvertIsDispatchedWithoutHeap )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+	SummingCbk     cbk;
+	BLEAddress     address( mac );
+
+	listener.init( &scanner );
+	listener.cbkRegister( &address, &cbk );
+
+	{
+		AllocationCounter counter;
+
+		for( int i = 0; i < 100; i++ )
+		{
+			scanner.deliver( mac, payload, sizeof( payload ) );
+			listener.process();
+		}
+
+		EXPECT_EQ( counter.count(), 0u );
+	}
+
+	EXPECT_EQ( cbk.sum, 100u * (0x11 + 0x22 + 0x50 + 0x20 + 0xAA) );
+}
+
+/* ************************************************************************** */
+
+TEST( Allocation, InjectedAdvertIsDecodedWithoutHeap )
+{
+	// global listener keeps pointers to registered devices, so sensor class is never deleted
+	LYWSDCGQ     &sensor = *new LYWSDCGQ();
+	BLEAddress   &address = *new BLEAddress( mac );
+	SensorValues values;
+
+	bleAdvListener.initInject();
+	sensor.init();
+	sensor.deviceRegister( &address, "alloc" );
+
+	{
+		AllocationCounter counter;
+
+		for( uint8_t i = 0; i < 100; i++ )
+		{
+			// MiBeacon of LYWSDCGQ with temperature and humidity object: 21.5 C, 45.0 %
+			uint8_t advPayload[] = { 0x02, 0x01, 0x06, 0x15, BLE_AD_TYPE_SERVICE_DATA, 0x95, 0xFE,
+					0x50, 0x20, 0xAA, 0x01, i, mac[5], mac[4], mac[3], mac[2], mac[1], mac[0],
+					0x0D, 0x10, 0x04, 0xD7, 0x00, 0xC2, 0x01 };
+
+			bleAdvListener.injectAdv( mac, advPayload, sizeof( advPayload ) );
+			bleAdvListener.process();
+		}
+
+		EXPECT_EQ( counter.count(), 0u );
+	}
+
+	ASSERT_TRUE( sensor.getData( address, &values ) );
+	EXPECT_FLOAT_EQ( values.temp, 21.5 );
+	EXPECT_FLOAT_EQ( values.humidity, 45.0 );
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,400 @@
+#include <gtest/gtest.h>
+#include "BleAdvListener.h"
+#include "BleTransportFake.h"
+#include <vector>
+
+/* ************************************************************************** */
+/**
+ * @brief Callback remembering all received service data
+ */
+class RecordingCbk : public BleAdvListenerCbk
+{
+public:
+	struct Record
+	{
+		std::string          address;
+		uint16_t             uuid;
+		std::vector<uint8_t> data;
+		int8_t               rssi;
+	};
+
+	std::vector<Record> records;
+
+	void onAdvData( BLEAddress *address, uint16_t serviceDataUUID, const AdvDataView &serviceData )
+	{
+		records.push_back( { address->toString(), serviceDataUUID,
+				std::vector<uint8_t>( serviceData.data, serviceData.data + serviceData.length ), serviceData.rssi } );
+	}
+};
+
+static uint8_t mac1[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x01 };
+static uint8_t mac2[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0x00, 0x00, 0x02 };
+
+// flags AD structure followed by two service data AD structures
+static const uint8_t payload[] = {
+	0x02, 0x01, 0x06,
+	0x05, BLE_AD_TYPE_SERVICE_DATA, 0x1A, 0x18, 0x11, 0x22,
+	0x04, BLE_AD_TYPE_SERVICE_DATA, 0x95, 0xFE, 0x33,
+};
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, DispatchesServiceDataOfRegisteredDevice )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+	RecordingCbk   cbk;
+	BLEAddress     address( mac1 );
+
+	listener.init( &scanner );
+	listener.cbkRegister( &address, &cbk );
+
+	scanner.deliver( mac1, payload, sizeof( payload ), -70 );
+	scanner.deliver( mac2, payload, sizeof( payload ), -60 );
+
+	// callbacks are called only from process()
+	EXPECT_TRUE( cbk.records.empty() );
+
+	listener.process();
+
+	ASSERT_EQ( cbk.records.size(), 2u );
+	EXPECT_EQ( cbk.records[0].address, "a4:c1:38:00:00:01" );
+	EXPECT_EQ( cbk.records[0].uuid, 0x181A );
+	EXPECT_EQ( cbk.records[0].data, std::vector<uint8_t>( { 0x11, 0x22 } ) );
+	EXPECT_EQ( cbk.records[0].rssi, -70 );
+	EXPECT_EQ( cbk.records[1].uuid, 0xFE95 );
+	EXPECT_EQ( cbk.records[1].data, std::vector<uint8_t>( { 0x33 } ) );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, FindsDevicesAfterIndexGrows )
+{
+	BleAdvListener            listener;
+	BleScannerFake            scanner;
+	std::vector<BLEAddress *> addresses;
+	RecordingCbk              cbks[100];
+
+	listener.init( &scanner );
+
+	for( int i = 0; i < 100; i++ )
+	{
+		uint8_t mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0x10, 0x00, (uint8_t) i };
+
+		addresses.push_back( new BLEAddress( mac ) );
+		listener.cbkRegister( addresses.back(), &cbks[i] );
+	}
+
+	for( int i = 0; i < 100; i++ )
+	{
+		scanner.deliver( *addresses[i]->getNative(), payload, sizeof( payload ) );
+		listener.process();
+
+		EXPECT_EQ( cbks[i].records.size(), 2u ) << "device " << i;
+	}
+
+	for( auto it = addresses.begin(); it != addresses.end(); it++ )
+	{
+		delete *it;
+	}
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, DropsRecordsWhenRingIsFull )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+	RecordingCbk   cbk;
+	BLEAddress     address( mac1 );
+
+	listener.init( &scanner );
+	listener.cbkRegister( &address, &cbk );
+
+	// every packet has 2 service data records
+	for( int i = 0; i < ADV_RING_SIZE; i++ )
+	{
+		scanner.deliver( mac1, payload, sizeof( payload ) );
+	}
+
+	EXPECT_EQ( listener.getRingDropped(), (uint32_t) ADV_RING_SIZE / 2 );
+	EXPECT_EQ( listener.getRingHighWater(), (uint32_t) ADV_RING_SIZE );
+
+	listener.process();
+
+	EXPECT_EQ( cbk.records.size(), (size_t) ADV_RING_SIZE );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, IgnoresMalformedPayload )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+	RecordingCbk   cbk;
+	BLEAddress     address( mac1 );
+
+	// second AD structure is longer than payload
+	const uint8_t truncated[] = { 0x02, 0x01, 0x06, 0x09, BLE_AD_TYPE_SERVICE_DATA, 0x1A, 0x18, 0x11 };
+
+	listener.init( &scanner );
+	listener.cbkRegister( &address, &cbk );
+
+	scanner.deliver( mac1, truncated, sizeof( truncated ) );
+	listener.process();
+
+	EXPECT_TRUE( cbk.records.empty() );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, StartsPeriodicScanWithDutyCycle )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	listener.init( &scanner );
+	listener.setDutyCycle( 300, 100 );
+	listener.process();
+
+	EXPECT_TRUE( listener.isScanRunning() );
+	EXPECT_EQ( scanner.startCount, 1u );
+	EXPECT_EQ( scanner.interval, 300 );
+	EXPECT_EQ( scanner.window, 100 );
+	EXPECT_NE( scanner.duration, 0u );
+
+	// next scan is started right after previous one is complete
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	scanner.complete();
+	EXPECT_FALSE( listener.isScanRunning() );
+
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 2u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, FailedScanStartIsRetriedWithBackoff )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	scanner.startResult = false;
+
+	listener.init( &scanner );
+	listener.process();
+	listener.process();
+
+	EXPECT_FALSE( listener.isScanRunning() );
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	// first retry is after 500 ms, next one after 1 s
+	delay( 600 );
+	listener.process();
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 2u );
+
+	delay( 600 );
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 2u );
+
+	scanner.startResult = true;
+	delay( 500 );
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 3u );
+	EXPECT_TRUE( listener.isScanRunning() );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ListeningFractionCountsFinishedScans )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	listener.init( &scanner );
+	listener.setDutyCycle( 100, 100 );
+	listener.process();
+
+	delay( 50 );
+	scanner.complete();
+
+	// scan finished in BT task is counted before process() adds it to total
+	float before = listener.getListeningFraction();
+
+	delay( 50 );
+	listener.setPaused( true );
+	listener.process();
+
+	float after = listener.getListeningFraction();
+
+	EXPECT_GT( before, 0.8 );
+	EXPECT_GT( after, 0.4 );
+	EXPECT_LT( after, 0.6 );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ContinuousScanNeedsScannerSupport )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	scanner.continuous = false;
+
+	listener.init( &scanner );
+	listener.setContinuous( true );
+
+	EXPECT_FALSE( listener.isContinuous() );
+
+	scanner.continuous = true;
+	listener.setContinuous( true );
+	listener.process();
+
+	EXPECT_TRUE( listener.isContinuous() );
+	EXPECT_EQ( scanner.duration, 0u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ContinuousScanIsStoppedWhenPaused )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	listener.init( &scanner );
+	listener.setContinuous( true );
+	listener.process();
+
+	listener.setPaused( true );
+	EXPECT_EQ( scanner.stopCount, 1u );
+	EXPECT_FALSE( listener.isScanRunning() );
+
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	listener.setPaused( false );
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 2u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ContinuousScanIsRestartedWithConnectionDutyCycle )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	listener.init( &scanner );
+	listener.setContinuous( true );
+	listener.setDutyCycle( 400, 150 );
+	listener.setConnDutyCycle( 400, 50 );
+	listener.process();
+
+	EXPECT_EQ( scanner.window, 150 );
+
+	listener.connBegin();
+	EXPECT_EQ( scanner.stopCount, 1u );
+
+	listener.process();
+	EXPECT_EQ( scanner.window, 50 );
+
+	listener.connEnd();
+	listener.process();
+	EXPECT_EQ( scanner.window, 150 );
+	EXPECT_EQ( scanner.startCount, 3u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ScanIsPausedDuringConnectionWithoutWindow )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	listener.init( &scanner );
+	listener.setConnDutyCycle( 400, 0 );
+	listener.process();
+
+	// periodic scan has to finish before connection
+	EXPECT_FALSE( listener.canConnect() );
+
+	scanner.complete();
+	EXPECT_TRUE( listener.canConnect() );
+
+	listener.connBegin();
+	listener.process();
+
+	EXPECT_FALSE( listener.isScanRunning() );
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	listener.connEnd();
+	listener.process();
+
+	EXPECT_EQ( scanner.startCount, 2u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, ContinuousScanIsStoppedBeforeConnectionWithoutWindow )
+{
+	BleAdvListener listener;
+	BleScannerFake scanner;
+
+	scanner.asyncStop = true;
+
+	listener.init( &scanner );
+	listener.setContinuous( true );
+	listener.setConnDutyCycle( 400, 0 );
+	listener.process();
+
+	EXPECT_FALSE( listener.canConnect() );
+
+	listener.connPrepare();
+	listener.connPrepare();
+	EXPECT_EQ( scanner.stopCount, 1u );
+
+	// stop is not complete yet
+	listener.process();
+	EXPECT_FALSE( listener.canConnect() );
+
+	scanner.completeStop();
+	EXPECT_TRUE( listener.canConnect() );
+
+	// scan is held for connection
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	listener.connBegin();
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 1u );
+
+	listener.connEnd();
+	listener.process();
+	EXPECT_EQ( scanner.startCount, 2u );
+}
+
+/* ************************************************************************** */
+
+TEST( BleAdvListener, InjectedPacketsNeedInjectMode )
+{
+	BleAdvListener listener;
+	RecordingCbk   cbk;
+	BLEAddress     address( mac1 );
+
+	listener.cbkRegister( &address, &cbk );
+
+	EXPECT_FALSE( listener.injectAdv( mac1, payload, sizeof( payload ) ) );
+
+	listener.initInject();
+
+	EXPECT_TRUE( listener.injectAdv( mac1, payload, sizeof( payload ), -50 ) );
+	listener.process();
+
+	ASSERT_EQ( cbk.records.size(), 2u );
+	EXPECT_EQ( cbk.records[0].rssi, -50 );
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,387 @@
+#include <gtest/gtest.h>
+#include "LYWSD03MMC.h"
+#include "BleTransportFake.h"
+#include <functional>
+
+/* ************************************************************************** */
+/**
+ * @brief Sensor class with fake sensor connected by fake transport. Objects are never deleted - worker
+ * tasks of sensor class and events of fake BT task keep pointers to them.
+ */
+class LYWSD03MMCTest : public ::testing::Test
+{
+protected:
+	LYWSD03MMC        *sensor;
+	BleFakeLYWSD03MMC *peer;
+	BLEAddress        *address;
+
+	/**
+	 * @brief Creates sensor class and fake sensor with unique address
+	 * @param[in] poolSize Number of concurrent connections of sensor class
+	 * @param[in] beforeInit Called with sensor class before its init()
+	 * @param[in] firmware Firmware of fake sensor
+	 */
+	void create( uint8_t poolSize = 1, std::function<void( LYWSD03MMC * )> beforeInit = nullptr,
+			BleFakeLYWSD03MMC::Firmware firmware = BleFakeLYWSD03MMC::FIRMWARE_STOCK )
+	{
+		addPeer( firmware );
+
+		sensor = new LYWSD03MMC();
+
+		if( beforeInit )
+		{
+			beforeInit( sensor );
+		}
+
+		sensor->init( 300, 10, poolSize );
+
+		bleAdvListener.initInject();
+	}
+
+	/**
+	 * @brief Creates another fake sensor with unique address - it becomes sensor used by other methods
+	 * @param[in] firmware Firmware of fake sensor
+	 */
+	void addPeer( BleFakeLYWSD03MMC::Firmware firmware = BleFakeLYWSD03MMC::FIRMWARE_STOCK )
+	{
+		static uint8_t next = 0;
+		uint8_t        mac[BLE_ADDRESS_LEN] = { 0xA4, 0xC1, 0x38, 0x20, 0x00, ++next };
+
+		address = new BLEAddress( mac );
+		peer = new BleFakeLYWSD03MMC( *address, firmware );
+		bleTransportFake.addPeripheral( peer );
+	}
+
+	/**
+	 * @brief Sends ADV packet of atc1441 firmware - sensor is near then
+	 * @param[in] temp Advertised temperature
+	 * @param[in] rssi RSSI of ADV packet in dBm
+	 */
+	void advertise( float temp = 19.0, int8_t rssi = -60 )
+	{
+		static uint8_t counter = 0;
+		const uint8_t *mac = *address->getNative();
+		int16_t        t = (int16_t) lroundf( temp * 10.0 );
+		uint8_t        payload[] = { 0x10, BLE_AD_TYPE_SERVICE_DATA, 0x1A, 0x18,
+				mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], (uint8_t) (t >> 8), (uint8_t) t, 40, 80, 0x0B, 0xB8, counter++ };
+
+		bleAdvListener.injectAdv( mac, payload, sizeof( payload ), rssi );
+		bleAdvListener.process();
+	}
+
+	/**
+	 * @brief Calls process() until condition is met
+	 * @param[in] condition Condition to wait for
+	 * @param[in] timeoutMs Max. time to wait
+	 * @return Returns true if condition was met
+	 */
+	bool processUntil( std::function<bool()> condition, uint32_t timeoutMs = 5000 )
+	{
+		for( uint32_t start = millis(); millis() - start < timeoutMs; delay( 1 ) )
+		{
+			sensor->process();
+
+			if( condition() )
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	SensorValues values()
+	{
+		SensorValues result;
+
+		sensor->getData( *address, &result );
+
+		return result;
+	}
+
+	SensorStats stats()
+	{
+		SensorStats result;
+
+		sensor->getStats( *address, &result );
+
+		return result;
+	}
+};
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, RefreshesDataByNotification )
+{
+	create();
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	EXPECT_FLOAT_EQ( values().temp, 19.0 );
+
+	ASSERT_TRUE( processUntil( [this]() { return values().temp == 21.5f; } ) );
+
+	SensorValues result = values();
+
+	EXPECT_FLOAT_EQ( result.humidity, 45.0 );
+	EXPECT_NEAR( result.voltage, 2.95, 0.001 );
+	EXPECT_EQ( peer->connectCount, 1u );
+	EXPECT_EQ( peer->discoverCount, 1u );
+
+	// fast connection parameters are requested for discovery
+	EXPECT_EQ( peer->minInterval, 6 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, KeepsConnectionProfileSetBeforeInit )
+{
+	create( 1, []( LYWSD03MMC *sensor ) {
+		sensor->setConnProfile( LYWSD03MMCConnParams( 24, 40, 0, 400 ), LYWSD03MMCConnParams() );
+	} );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().notifyOk == 1; } ) );
+
+	EXPECT_EQ( peer->minInterval, 24 );
+	EXPECT_EQ( peer->maxInterval, 40 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, ReadsDataDirectly )
+{
+	create();
+	sensor->setDirectRead( true );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().readOk == 1; } ) );
+
+	EXPECT_FLOAT_EQ( values().temp, 21.5 );
+	EXPECT_EQ( stats().notifyOk, 0u );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, FallsBackToNotificationWhenReadFails )
+{
+	create();
+	peer->readable = false;
+	sensor->setDirectRead( true );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().notifyOk == 1; } ) );
+
+	EXPECT_EQ( stats().readFailed, 1u );
+	EXPECT_FLOAT_EQ( values().temp, 21.5 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, ReusesCachedHandles )
+{
+	create();
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return values().temp == 21.5f; } ) );
+
+	peer->temp = 23.0;
+	sensor->forceRefresh( *address );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return values().temp == 23.0f; } ) );
+
+	EXPECT_EQ( peer->connectCount, 2u );
+	EXPECT_EQ( peer->discoverCount, 1u );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, RefreshesDevicesConcurrently )
+{
+	create( 2 );
+	BleFakeLYWSD03MMC *first = peer;
+
+	first->notifyDelayMs = 2000;
+	sensor->deviceRegister( address, "first" );
+	advertise();
+
+	addPeer();
+	BleFakeLYWSD03MMC *second = peer;
+
+	second->notifyDelayMs = 2000;
+	sensor->deviceRegister( address, "second" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [first, second]() { return first->connectCount + second->connectCount != 0; } ) );
+
+	// the other device is connected by second connection of pool - it doesn't wait for notification of the first one
+	EXPECT_TRUE( processUntil( [first, second]() { return first->connectCount == 1 && second->connectCount == 1; }, 1000 ) );
+	EXPECT_TRUE( processUntil( [this]() { return values().temp == 21.5f; } ) );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, DoesNotConnectToFarDevice )
+{
+	create();
+	sensor->deviceRegister( address, "test" );
+
+	EXPECT_FALSE( processUntil( [this]() { return peer->connectCount != 0; }, 200 ) );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, DoesNotConnectToDeviceBelowRssiFloor )
+{
+	create();
+	sensor->setRssiFloor( -80 );
+	sensor->deviceRegister( address, "test" );
+	advertise( 19.0, -90 );
+
+	EXPECT_FALSE( processUntil( [this]() { return peer->connectCount != 0; }, 200 ) );
+	EXPECT_FLOAT_EQ( stats().rssi, -90.0 );
+
+	// forced refresh connects regardless of signal
+	sensor->forceRefresh( *address );
+
+	EXPECT_TRUE( processUntil( [this]() { return values().temp == 21.5f; } ) );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, SurvivesFailedConnection )
+{
+	create();
+	peer->connectable = false;
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	EXPECT_FALSE( processUntil( [this]() { return values().temp == 21.5f; }, 200 ) );
+	EXPECT_EQ( peer->connectCount, 0u );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, CountsFailedConnection )
+{
+	create();
+	peer->connectable = false;
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().connFailed == 1; } ) );
+
+	EXPECT_EQ( stats().connFailStreak, 1u );
+	EXPECT_GT( stats().retryAt, 0 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, AdaptiveRefreshNeverReachesZeroInterval )
+{
+	create();
+	sensor->setAdaptiveRefresh( 0, 600, 0.1, 1.0 );
+	sensor->deviceRegister( address, "test" );
+
+	// every refresh sees big change of temperature - interval is halved from 300 s
+	for( uint32_t i = 1; i <= 12; i++ )
+	{
+		peer->temp = (i & 1) ? 20.0 : 30.0;
+
+		if( i > 1 )
+		{
+			sensor->forceRefresh( *address );
+		}
+
+		advertise();
+
+		ASSERT_TRUE( processUntil( [this, i]() { return stats().notifyOk == i; } ) );
+	}
+
+	EXPECT_EQ( stats().refreshInterval, 1 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, BackfillsHistory )
+{
+	LYWSD03MMCHistory records[LYWSD03MMC_HISTORY_SIZE];
+
+	create();
+
+	// sensor clock is not set - it started with battery insertion
+	peer->clockSkew = 1000000 + 5 * LYWSD03MMC_HISTORY_PERIOD - time( NULL );
+
+	for( uint32_t i = 0; i < 5; i++ )
+	{
+		peer->addHistory( 1000000 + i * LYWSD03MMC_HISTORY_PERIOD );
+	}
+
+	sensor->setBackfill( 3 );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().histRecords == 3; } ) );
+
+	// only the newest records fit to limit
+	ASSERT_EQ( sensor->getHistory( *address, records, LYWSD03MMC_HISTORY_SIZE ), 3u );
+	EXPECT_EQ( records[0].index, 2u );
+	EXPECT_EQ( records[2].index, 4u );
+	EXPECT_FLOAT_EQ( records[2].tempMax, 22.0 );
+	EXPECT_FLOAT_EQ( records[2].humidityMin, 43.0 );
+
+	// timestamps are converted from sensor clock to gateway clock
+	EXPECT_NEAR( records[2].timestamp, 1000000 + 4 * LYWSD03MMC_HISTORY_PERIOD - peer->clockSkew, 2 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, BackfillsLogOfPvvxFirmware )
+{
+	LYWSD03MMCHistory records[LYWSD03MMC_HISTORY_SIZE];
+
+	create( 1, nullptr, BleFakeLYWSD03MMC::FIRMWARE_PVVX );
+	peer->clockSkew = 1000000 + 5 * LYWSD03MMC_HISTORY_PERIOD - time( NULL );
+
+	for( uint32_t i = 0; i < 5; i++ )
+	{
+		peer->addHistory( 1000000 + i * LYWSD03MMC_HISTORY_PERIOD );
+	}
+
+	sensor->setBackfill( 3 );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().histRecords == 3; } ) );
+
+	// only the newest records fit to limit - they are stored from the oldest one
+	ASSERT_EQ( sensor->getHistory( *address, records, LYWSD03MMC_HISTORY_SIZE ), 3u );
+	EXPECT_NEAR( records[0].timestamp, 1000000 + 2 * LYWSD03MMC_HISTORY_PERIOD - peer->clockSkew, 2 );
+	EXPECT_NEAR( records[2].timestamp, 1000000 + 4 * LYWSD03MMC_HISTORY_PERIOD - peer->clockSkew, 2 );
+	EXPECT_FLOAT_EQ( records[2].tempMax, 21.5 );
+	EXPECT_FLOAT_EQ( records[2].tempMin, 21.5 );
+	EXPECT_FLOAT_EQ( records[2].humidityMax, 45.0 );
+}
+
+/* ************************************************************************** */
+
+TEST_F( LYWSD03MMCTest, SkipsHistoryOfFirmwareWithoutIt )
+{
+	LYWSD03MMCHistory records[LYWSD03MMC_HISTORY_SIZE];
+
+	create( 1, nullptr, BleFakeLYWSD03MMC::FIRMWARE_NO_HISTORY );
+	sensor->setBackfill( 10 );
+	sensor->deviceRegister( address, "test" );
+	advertise();
+
+	ASSERT_TRUE( processUntil( [this]() { return stats().notifyOk == 1; } ) );
+
+	EXPECT_EQ( sensor->getHistory( *address, records, LYWSD03MMC_HISTORY_SIZE ), 0u );
+}
+
+/* ************************************************************************** */